@@ -0,0 +1,107 @@
+#include "../src/include/utf8.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/**
+ * Compares utf8_decode_string against decoding one codepoint at a time
+ * on an all ASCII text, a mixed Latin, Greek, CJK and emoji text and a CJK only text.
+ */
+
+#define BENCH_TEXT_SIZE (1 << 20)
+#define BENCH_ROUNDS 200
+
+static double bench_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char* bench_make_text(const char* pattern)
+{
+    size_t pattern_length = strlen(pattern);
+    char* text = malloc(BENCH_TEXT_SIZE + 1);
+    size_t size = 0;
+
+    while (size + pattern_length <= BENCH_TEXT_SIZE)
+    {
+        memcpy(&text[size], pattern, pattern_length);
+        size += pattern_length;
+    }
+
+    text[size] = 0;
+
+    return text;
+}
+
+static size_t bench_decode_scalar(const char* text, uint32_t* codepoints)
+{
+    size_t count = 0;
+
+    while (*text != 0)
+        codepoints[count++] = utf8_decode(&text);
+
+    return count;
+}
+
+static void bench_run(const char* name, const char* text)
+{
+    size_t length = strlen(text);
+    uint32_t* scalar = malloc(sizeof(uint32_t) * length);
+    uint32_t* simd = malloc(sizeof(uint32_t) * length);
+    size_t scalar_count = 0;
+    size_t simd_count = 0;
+
+    double start = bench_now();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+        scalar_count = bench_decode_scalar(text, scalar);
+    double scalar_time = bench_now() - start;
+
+    start = bench_now();
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+        simd_count = utf8_decode_string(text, length, simd);
+    double simd_time = bench_now() - start;
+
+    if (scalar_count != simd_count || memcmp(scalar, simd, sizeof(uint32_t) * simd_count) != 0)
+        fprintf(stderr, "ERROR::UTF8_BENCH: Decoders disagree on %s text\n", name);
+
+    double megabytes = (double) length * BENCH_ROUNDS / (1 << 20);
+
+    fprintf(
+        stdout,
+        "%-6s scalar %8.1f MB/s, utf8_decode_string %8.1f MB/s (%.2fx)\n",
+        name,
+        megabytes / scalar_time,
+        megabytes / simd_time,
+        scalar_time / simd_time
+    );
+
+    free(scalar);
+    free(simd);
+}
+
+int main()
+{
+    char* ascii = bench_make_text("The quick brown fox jumps over the lazy dog. 0123456789\n");
+    char* mixed = bench_make_text(
+        "Caf\xC3\xA9 na\xC3\xAFve \xCE\xBA\xCF\x8C\xCF\x83\xCE\xBC\xCE\xB5 "
+        "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E \xF0\x9F\x98\x80 plain ascii words in between\n"
+    );
+    char* cjk = bench_make_text(
+        "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE\xE6\x96\x87\xE7\xAB\xA0\xE3\x81\xA7\xE3\x81\x99\xE3\x80\x82"
+    );
+
+    bench_run("ascii", ascii);
+    bench_run("mixed", mixed);
+    bench_run("cjk", cjk);
+
+    free(ascii);
+    free(mixed);
+    free(cjk);
+
+    return 0;
+}
@@ -0,0 +1,1270 @@
+#include "include/atlas.h"
+#include "include/stream_buffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static atlas_page_T** pages = (void*)0;
+static size_t pages_size = 0;
+
+// Pages only live in CPU memory, used by tools running without a GL context
+static int headless = 0;
+
+// Texture memory of the live pages and the most it should grow to
+static size_t bytes = 0;
+static size_t budget = ATLAS_BUDGET_UNLIMITED;
+static int (*evict)(int format) = (void*)0;
+
+// Page the glyphs of the pages being repacked are moved into, -1 while no repack runs
+static int repack_target = -1;
+static int repack_blocked = 0;    // The last repack was stopped, retried once pages are added or released
+static unsigned long relocations = 0;
+static GLuint repack_framebuffers[2];
+
+// Pixel unpack buffer ring every upload is staged in, created with the first one
+static stream_buffer_T* staging = (void*)0;
+
+// Ring of the upload thread's context, only used by its jobs
+static stream_buffer_T* upload_staging = (void*)0;
+
+void atlas_set_headless(int enabled)
+{
+    headless = enabled;
+}
+
+/**
+ * Bytes per texel of a page format.
+ */
+int atlas_get_channels(int format)
+{
+    return format == ATLAS_FORMAT_MSDF ? 3 : 1;
+}
+
+static GLenum atlas_get_gl_format(int format)
+{
+    return format == ATLAS_FORMAT_MSDF ? GL_RGB : GL_RED;
+}
+
+/**
+ * Texture memory of a page, both of its textures are full size, see atlas_publish.
+ */
+static size_t atlas_page_bytes(int format, int width, int height)
+{
+    return 2 * (size_t)width * height * atlas_get_channels(format);
+}
+
+/**
+ * Creates both textures of a page from its CPU copy.
+ */
+static void atlas_page_create_texture(atlas_page_T* page)
+{
+    GLint internal_format = page->format == ATLAS_FORMAT_MSDF ? GL_RGB8 : GL_R8;
+
+    // Distance fields are interpolated, the edge is reconstructed between texels
+    GLint filter = page->format == ATLAS_FORMAT_COVERAGE ? GL_NEAREST : GL_LINEAR;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (int i = 0; i < 2; i++)
+    {
+        glGenTextures(1, &page->buffers[i].texture);
+        glBindTexture(GL_TEXTURE_2D, page->buffers[i].texture);
+        glTexImage2D(
+            GL_TEXTURE_2D,
+            0,
+            internal_format,
+            page->width,
+            page->height,
+            0,
+            atlas_get_gl_format(page->format),
+            GL_UNSIGNED_BYTE,
+            page->pixels
+        );
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static void atlas_buffer_add_pending(atlas_buffer_T* buffer, int x, int y, int width, int height)
+{
+    if (buffer->pending_size == buffer->pending_capacity)
+    {
+        buffer->pending_capacity = buffer->pending_capacity ? buffer->pending_capacity * 2 : 16;
+        buffer->pending = realloc(buffer->pending, sizeof(struct ATLAS_RECT_STRUCT) * buffer->pending_capacity);
+    }
+
+    atlas_rect_T* rect = &buffer->pending[buffer->pending_size++];
+    rect->x = x;
+    rect->y = y;
+    rect->width = width;
+    rect->height = height;
+}
+
+/**
+ * Records a change to the CPU copy of a page, both textures receive it from atlas_publish.
+ */
+static void atlas_page_invalidate(atlas_page_T* page, int x, int y, int width, int height)
+{
+    if (headless)
+        return;
+
+    atlas_buffer_add_pending(&page->buffers[0], x, y, width, height);
+    atlas_buffer_add_pending(&page->buffers[1], x, y, width, height);
+}
+
+static size_t atlas_rect_area(const atlas_rect_T* rect)
+{
+    return (size_t)rect->width * rect->height;
+}
+
+static atlas_rect_T atlas_rect_union(const atlas_rect_T* a, const atlas_rect_T* b)
+{
+    atlas_rect_T rect;
+    rect.x = a->x < b->x ? a->x : b->x;
+    rect.y = a->y < b->y ? a->y : b->y;
+    rect.width = (a->x + a->width > b->x + b->width ? a->x + a->width : b->x + b->width) - rect.x;
+    rect.height = (a->y + a->height > b->y + b->height ? a->y + a->height : b->y + b->height) - rect.y;
+
+    return rect;
+}
+
+/**
+ * Merges pending rects into their bounding box while it stays within ATLAS_COALESCE_WASTE
+ * of the texels they cover, so neighbouring glyphs go up in one call.
+ * The extra texels come from the CPU copy as well, uploading them again is harmless.
+ */
+static void atlas_buffer_coalesce(atlas_buffer_T* buffer)
+{
+    int merged = 1;
+
+    while (merged)
+    {
+        merged = 0;
+
+        for (size_t i = 0; i < buffer->pending_size; i++)
+        {
+            for (size_t j = i + 1; j < buffer->pending_size; j++)
+            {
+                atlas_rect_T* a = &buffer->pending[i];
+                atlas_rect_T* b = &buffer->pending[j];
+                atlas_rect_T rect = atlas_rect_union(a, b);
+
+                if (atlas_rect_area(&rect) > (atlas_rect_area(a) + atlas_rect_area(b)) * ATLAS_COALESCE_WASTE)
+                    continue;
+
+                *a = rect;
+                *b = buffer->pending[--buffer->pending_size];
+                merged = 1;
+                j = i;
+            }
+        }
+    }
+}
+
+/**
+ * Coalesces the pending rects of a texture and writes their rows tightly packed to `data`.
+ * Returns the bytes written, 0 leaves nothing to upload.
+ */
+static size_t atlas_buffer_pack(atlas_page_T* page, atlas_buffer_T* buffer, unsigned char* data)
+{
+    int channels = atlas_get_channels(page->format);
+    size_t offset = 0;
+
+    for (size_t i = 0; i < buffer->pending_size; i++)
+    {
+        atlas_rect_T* rect = &buffer->pending[i];
+        size_t row = (size_t)rect->width * channels;
+
+        for (int y = 0; y < rect->height; y++)
+        {
+            memcpy(
+                data + offset,
+                &page->pixels[((size_t)(rect->y + y) * page->width + rect->x) * channels],
+                row
+            );
+            offset += row;
+        }
+    }
+
+    return offset;
+}
+
+static size_t atlas_buffer_pending_bytes(atlas_page_T* page, atlas_buffer_T* buffer)
+{
+    size_t total = 0;
+
+    for (size_t i = 0; i < buffer->pending_size; i++)
+        total += atlas_rect_area(&buffer->pending[i]) * atlas_get_channels(page->format);
+
+    return total;
+}
+
+/**
+ * Uploads rects packed by atlas_buffer_pack, `pixels` is a client pointer or an offset
+ * into the bound pixel unpack buffer.
+ */
+static void atlas_texture_upload(GLuint texture, int format, const atlas_rect_T* rects, size_t rects_size, const unsigned char* pixels)
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    for (size_t i = 0; i < rects_size; i++)
+    {
+        const atlas_rect_T* rect = &rects[i];
+
+        glTexSubImage2D(
+            GL_TEXTURE_2D,
+            0,
+            rect->x,
+            rect->y,
+            rect->width,
+            rect->height,
+            atlas_get_gl_format(format),
+            GL_UNSIGNED_BYTE,
+            pixels
+        );
+
+        pixels += atlas_rect_area(rect) * atlas_get_channels(format);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/**
+ * Copies every rectangle a texture of a page is missing from the CPU copy.
+ * The rects are coalesced and their rows written tightly packed into the staging ring,
+ * glTexSubImage2D then sources them from the pixel buffer and returns without
+ * waiting for the transfer.
+ */
+static void atlas_buffer_upload(atlas_page_T* page, atlas_buffer_T* buffer)
+{
+    atlas_buffer_coalesce(buffer);
+
+    size_t total = atlas_buffer_pending_bytes(page, buffer);
+
+    // Nothing but empty rects
+    if (total == 0)
+    {
+        buffer->pending_size = 0;
+        return;
+    }
+
+    if (staging == (void*)0)
+        staging = init_stream_buffer(GL_PIXEL_UNPACK_BUFFER, ATLAS_STAGING_SIZE);
+
+    size_t offset;
+    atlas_buffer_pack(page, buffer, stream_buffer_map(staging, total, 4, &offset));
+    stream_buffer_unmap(staging);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging->buffer);
+    atlas_texture_upload(buffer->texture, page->format, buffer->pending, buffer->pending_size, (void*)offset);
+
+    // Uploads from client memory elsewhere would read from the buffer otherwise
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    buffer->pending_size = 0;
+}
+
+/**
+ * Pending rects of a texture copied out of the CPU copy for the upload thread,
+ * rects and texels follow in the same allocation.
+ */
+typedef struct ATLAS_UPLOAD_STRUCT
+{
+    GLuint texture;
+    int format;
+    atlas_rect_T* rects;
+    size_t rects_size;
+    unsigned char* pixels;
+    size_t pixels_size;
+} atlas_upload_T;
+
+/**
+ * Stages the texels of a job in the upload thread's own ring, so glTexSubImage2D
+ * returns without waiting for the transfer like it does on the render thread.
+ * Every job is a frame of the ring, a region is only written again once the GPU read it.
+ */
+static void atlas_upload_run(void* data)
+{
+    atlas_upload_T* upload = data;
+
+    if (upload_staging == (void*)0)
+        upload_staging = init_stream_buffer(GL_PIXEL_UNPACK_BUFFER, ATLAS_STAGING_SIZE);
+
+    size_t offset;
+    memcpy(stream_buffer_map(upload_staging, upload->pixels_size, 4, &offset), upload->pixels, upload->pixels_size);
+    stream_buffer_unmap(upload_staging);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_staging->buffer);
+    atlas_texture_upload(upload->texture, upload->format, upload->rects, upload->rects_size, (void*)offset);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    stream_buffer_end_frame(upload_staging);
+}
+
+/**
+ * Hands the pending rects of an idle texture to the upload thread,
+ * atlas_publish makes it the front one once the job is done.
+ */
+static void atlas_buffer_submit(atlas_page_T* page, atlas_buffer_T* buffer)
+{
+    atlas_buffer_coalesce(buffer);
+
+    size_t total = atlas_buffer_pending_bytes(page, buffer);
+
+    if (total == 0)
+    {
+        buffer->pending_size = 0;
+        return;
+    }
+
+    size_t rects_bytes = sizeof(struct ATLAS_RECT_STRUCT) * buffer->pending_size;
+    atlas_upload_T* upload = malloc(sizeof(struct ATLAS_UPLOAD_STRUCT) + rects_bytes + total);
+    upload->texture = buffer->texture;
+    upload->format = page->format;
+    upload->rects = (atlas_rect_T*)(upload + 1);
+    upload->rects_size = buffer->pending_size;
+    upload->pixels = (unsigned char*)upload->rects + rects_bytes;
+    upload->pixels_size = total;
+
+    memcpy(upload->rects, buffer->pending, rects_bytes);
+    atlas_buffer_pack(page, buffer, upload->pixels);
+
+    buffer->upload = upload_thread_submit(atlas_upload_run, upload);
+    buffer->pending_size = 0;
+}
+
+/**
+ * Whether the GPU is done with every draw that sampled a texture, never blocks.
+ */
+static int atlas_buffer_idle(atlas_buffer_T* buffer)
+{
+    if (buffer->upload != (void*)0)
+        return 0;
+
+    if (!buffer->fence)
+        return 1;
+
+    GLenum result = glClientWaitSync(buffer->fence, 0, 0);
+
+    if (result == GL_TIMEOUT_EXPIRED)
+        return 0;
+
+    if (result == GL_WAIT_FAILED)
+        perror("ERROR::ATLAS: Failed to poll fence");
+
+    glDeleteSync(buffer->fence);
+    buffer->fence = 0;
+
+    return 1;
+}
+
+static void atlas_page_delete_textures(atlas_page_T* page)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        atlas_buffer_T* buffer = &page->buffers[i];
+
+        if (!headless)
+        {
+            // The name could be handed out again while the upload thread still writes it
+            if (buffer->upload != (void*)0)
+                upload_job_release(buffer->upload);
+
+            glDeleteTextures(1, &buffer->texture);
+
+            if (buffer->fence)
+                glDeleteSync(buffer->fence);
+        }
+
+        free(buffer->pending);
+        memset(buffer, 0, sizeof(struct ATLAS_BUFFER_STRUCT));
+    }
+}
+
+/**
+ * The skyline of a plot starts out as one flat segment along its bottom.
+ */
+static void atlas_plot_reset(atlas_plot_T* plot)
+{
+    plot->nodes = realloc(plot->nodes, sizeof(struct ATLAS_SKYLINE_NODE_STRUCT));
+    plot->nodes[0].x = 0;
+    plot->nodes[0].y = 0;
+    plot->nodes[0].width = ATLAS_PLOT_SIZE;
+    plot->nodes_size = 1;
+    plot->glyphs = 0;
+}
+
+/**
+ * Takes a page into the list, in the slot of a released page if there is one
+ * so the indices of the other pages never change.
+ * Returns the index of the page.
+ */
+static unsigned int atlas_store_page(atlas_page_T* page)
+{
+    bytes += atlas_page_bytes(page->format, page->width, page->height);
+    repack_blocked = 0;
+
+    for (unsigned int i = 0; i < pages_size; i++)
+    {
+        if (pages[i]->pixels != (void*)0)
+            continue;
+
+        // Layouts made with glyphs of the old page are still told apart
+        page->relocated = pages[i]->relocated;
+
+        free(pages[i]);
+        pages[i] = page;
+
+        return i;
+    }
+
+    pages_size += 1;
+    pages = realloc(pages, sizeof(struct ATLAS_PAGE_STRUCT*) * pages_size);
+    pages[pages_size - 1] = page;
+
+    return pages_size - 1;
+}
+
+static void atlas_page_free_plots(atlas_page_T* page)
+{
+    if (page->plots == (void*)0)
+        return;
+
+    for (size_t i = 0; i < ATLAS_PAGE_PLOTS; i++)
+        free(page->plots[i].nodes);
+
+    free(page->plots);
+    page->plots = (void*)0;
+}
+
+/**
+ * Gives the texture memory of an empty page back, its slot is reused by the next new page.
+ */
+static void atlas_page_release(atlas_page_T* page)
+{
+    bytes -= atlas_page_bytes(page->format, page->width, page->height);
+    repack_blocked = 0;
+
+    // Layouts with glyphs on it are made again before the slot holds another page
+    relocations += 1;
+    page->relocated = relocations;
+
+    atlas_page_delete_textures(page);
+    free(page->pixels);
+    atlas_page_free_plots(page);
+
+    page->pixels = (void*)0;
+    page->repacking = 0;
+}
+
+static unsigned int atlas_page_new(int format, int width, int height)
+{
+    atlas_page_T* page = calloc(1, sizeof(struct ATLAS_PAGE_STRUCT));
+    page->format = format;
+    page->width = width;
+    page->height = height;
+
+    page->plots = calloc(ATLAS_PAGE_PLOTS, sizeof(struct ATLAS_PLOT_STRUCT));
+    for (size_t i = 0; i < ATLAS_PAGE_PLOTS; i++)
+        atlas_plot_reset(&page->plots[i]);
+
+    // Texture storage is not guaranteed to be zeroed, padding must read as empty
+    page->pixels = calloc((size_t)width * height, atlas_get_channels(format));
+
+    if (!headless)
+        atlas_page_create_texture(page);
+
+    return atlas_store_page(page);
+}
+
+/**
+ * Returns the lowest y a rectangle of the given width can be placed at
+ * when its left edge sits on skyline node `index`, or -1 if it does not fit.
+ */
+static int atlas_plot_fit(atlas_plot_T* plot, size_t index, int width, int height)
+{
+    int x = plot->nodes[index].x;
+
+    if (x + width > ATLAS_PLOT_SIZE)
+        return -1;
+
+    int y = 0;
+    int remaining = width;
+
+    for (size_t i = index; remaining > 0; i++)
+    {
+        if (plot->nodes[i].y > y)
+            y = plot->nodes[i].y;
+
+        if (y + height > ATLAS_PLOT_SIZE)
+            return -1;
+
+        remaining -= plot->nodes[i].width;
+    }
+
+    return y;
+}
+
+/**
+ * Skyline bottom-left packing: finds the position with the lowest top edge,
+ * breaking ties by the narrowest skyline segment.
+ * Returns its y with the node it starts on in `out_index`, or -1 if the rectangle does not fit.
+ */
+static int atlas_plot_find(atlas_plot_T* plot, int width, int height, size_t* out_index)
+{
+    int best_y = -1;
+    int best_width = 0;
+
+    for (size_t i = 0; i < plot->nodes_size; i++)
+    {
+        int y = atlas_plot_fit(plot, i, width, height);
+
+        if (y < 0)
+            continue;
+
+        if (best_y < 0 || y < best_y || (y == best_y && plot->nodes[i].width < best_width))
+        {
+            best_y = y;
+            best_width = plot->nodes[i].width;
+            *out_index = i;
+        }
+    }
+
+    return best_y;
+}
+
+/**
+ * Raises the skyline over a rectangle placed at node `index` by atlas_plot_find.
+ */
+static void atlas_plot_insert(atlas_plot_T* plot, size_t index, int y, int width, int height)
+{
+    int x = plot->nodes[index].x;
+
+    // Insert the new segment covering the placed rectangle
+    plot->nodes = realloc(plot->nodes, sizeof(struct ATLAS_SKYLINE_NODE_STRUCT) * (plot->nodes_size + 1));
+    memmove(
+        &plot->nodes[index + 1],
+        &plot->nodes[index],
+        sizeof(struct ATLAS_SKYLINE_NODE_STRUCT) * (plot->nodes_size - index)
+    );
+    plot->nodes[index].x = x;
+    plot->nodes[index].y = y + height;
+    plot->nodes[index].width = width;
+    plot->nodes_size += 1;
+
+    // Shrink or remove the segments now hidden below it
+    size_t i = index + 1;
+    while (i < plot->nodes_size)
+    {
+        atlas_skyline_node_T* node = &plot->nodes[i];
+        int end = x + width;
+
+        if (node->x >= end)
+            break;
+
+        int shrink = end - node->x;
+
+        if (shrink < node->width)
+        {
+            node->x += shrink;
+            node->width -= shrink;
+            break;
+        }
+
+        memmove(
+            &plot->nodes[i],
+            &plot->nodes[i + 1],
+            sizeof(struct ATLAS_SKYLINE_NODE_STRUCT) * (plot->nodes_size - i - 1)
+        );
+        plot->nodes_size -= 1;
+    }
+
+    // Merge neighbouring segments of equal height
+    for (i = 0; i + 1 < plot->nodes_size;)
+    {
+        if (plot->nodes[i].y == plot->nodes[i + 1].y)
+        {
+            plot->nodes[i].width += plot->nodes[i + 1].width;
+            memmove(
+                &plot->nodes[i + 1],
+                &plot->nodes[i + 2],
+                sizeof(struct ATLAS_SKYLINE_NODE_STRUCT) * (plot->nodes_size - i - 2)
+            );
+            plot->nodes_size -= 1;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    plot->glyphs += 1;
+}
+
+/**
+ * Places a rectangle on a page at the lowest position any of its plots has,
+ * so a page fills up row of plots by row of plots.
+ */
+static int atlas_page_insert(atlas_page_T* page, int width, int height, int* out_x, int* out_y)
+{
+    int plots_per_row = page->width / ATLAS_PLOT_SIZE;
+    int best_y = -1;
+    size_t best_plot = 0;
+    size_t best_index = 0;
+
+    for (size_t i = 0; i < ATLAS_PAGE_PLOTS; i++)
+    {
+        size_t index = 0;
+        int y = atlas_plot_find(&page->plots[i], width, height, &index);
+
+        if (y < 0)
+            continue;
+
+        y += (i / plots_per_row) * ATLAS_PLOT_SIZE;
+
+        if (best_y < 0 || y < best_y)
+        {
+            best_y = y;
+            best_plot = i;
+            best_index = index;
+        }
+    }
+
+    if (best_y < 0)
+        return 0;
+
+    atlas_plot_T* plot = &page->plots[best_plot];
+    int plot_x = (best_plot % plots_per_row) * ATLAS_PLOT_SIZE;
+    int plot_y = (best_plot / plots_per_row) * ATLAS_PLOT_SIZE;
+
+    *out_x = plot_x + plot->nodes[best_index].x;
+    *out_y = best_y;
+    atlas_plot_insert(plot, best_index, best_y - plot_y, width, height);
+
+    page->glyphs += 1;
+    page->area += (size_t)width * height;
+
+    return 1;
+}
+
+/**
+ * Places a rectangle on the first page of a format with room for it.
+ * Pages taking part in a repack are skipped, they are meant to empty out
+ * and to fit the glyphs moved off them.
+ */
+static int atlas_place(int format, int width, int height, unsigned int* out_page, int* out_x, int* out_y)
+{
+    for (unsigned int i = 0; i < pages_size; i++)
+    {
+        // Pages are drawn with a single filter and shader
+        if (pages[i]->plots == (void*)0 || pages[i]->format != format)
+            continue;
+
+        if (pages[i]->repacking || (int)i == repack_target)
+            continue;
+
+        if (atlas_page_insert(pages[i], width, height, out_x, out_y))
+        {
+            *out_page = i;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Whether any rectangle a texture is missing overlaps the given one.
+ */
+static int atlas_buffer_overlaps(atlas_buffer_T* buffer, int x, int y, int width, int height)
+{
+    for (size_t i = 0; i < buffer->pending_size; i++)
+    {
+        atlas_rect_T* rect = &buffer->pending[i];
+
+        if (rect->x < x + width && x < rect->x + rect->width && rect->y < y + height && y < rect->y + rect->height)
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Copies texels on the GPU with glCopyImageSubData or else a framebuffer blit.
+ * Returns 0 when neither works.
+ */
+static int atlas_texture_copy(GLuint source, int source_x, int source_y, GLuint target, int x, int y, int width, int height)
+{
+    if (GLEW_ARB_copy_image)
+    {
+        glCopyImageSubData(
+            source, GL_TEXTURE_2D, 0, source_x, source_y, 0,
+            target, GL_TEXTURE_2D, 0, x, y, 0,
+            width, height, 1
+        );
+        return 1;
+    }
+
+    if (repack_framebuffers[0] == 0)
+        glGenFramebuffers(2, repack_framebuffers);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, repack_framebuffers[0]);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, source, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, repack_framebuffers[1]);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+
+    int blitted = 0;
+
+    if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE
+        && glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+    {
+        glBlitFramebuffer(
+            source_x, source_y, source_x + width, source_y + height,
+            x, y, x + width, y + height,
+            GL_COLOR_BUFFER_BIT,
+            GL_NEAREST
+        );
+        blitted = 1;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return blitted;
+}
+
+/**
+ * Makes the back texture of a page the front one once the upload thread filled it,
+ * blocking for the job when `wait` is set.
+ * Returns 0 while the job is still running.
+ */
+static int atlas_page_take_upload(atlas_page_T* page, int wait)
+{
+    atlas_buffer_T* back = &page->buffers[!page->front];
+
+    if (back->upload == (void*)0)
+        return 1;
+
+    if (!wait && !upload_job_done(back->upload))
+        return 0;
+
+    upload_job_release(back->upload);
+    back->upload = (void*)0;
+    page->front = !page->front;
+
+    return 1;
+}
+
+/**
+ * Copies texels between two pages of the same format, CPU copies included.
+ * The back texture of the target is written on the GPU when the front texture
+ * of the source holds the texels and no draw still samples the back one,
+ * everything else is uploaded from the CPU copy by atlas_publish.
+ * While the upload thread runs, the front texture of the target is written right away instead,
+ * layouts are made again with the moved glyphs before the thread could have filled it.
+ */
+static void atlas_page_copy(atlas_page_T* source, int source_x, int source_y, atlas_page_T* target, int x, int y, int width, int height)
+{
+    int channels = atlas_get_channels(source->format);
+    for (int row = 0; row < height; row++)
+    {
+        memcpy(
+            &target->pixels[((size_t)(y + row) * target->width + x) * channels],
+            &source->pixels[((size_t)(source_y + row) * source->width + source_x) * channels],
+            (size_t)width * channels
+        );
+    }
+
+    if (headless)
+        return;
+
+    atlas_buffer_T* source_front = &source->buffers[source->front];
+
+    if (upload_thread_running())
+    {
+        // The texture being filled becomes the front one without the moved texels otherwise
+        atlas_page_take_upload(target, 1);
+
+        atlas_buffer_T* front = &target->buffers[target->front];
+
+        if (!atlas_buffer_overlaps(source_front, source_x, source_y, width, height)
+            && atlas_texture_copy(source_front->texture, source_x, source_y, front->texture, x, y, width, height))
+        {
+            atlas_buffer_add_pending(&target->buffers[!target->front], x, y, width, height);
+            return;
+        }
+
+        atlas_page_invalidate(target, x, y, width, height);
+        atlas_buffer_upload(target, front);
+        return;
+    }
+
+    atlas_buffer_T* target_front = &target->buffers[target->front];
+    atlas_buffer_T* target_back = &target->buffers[!target->front];
+
+    if (!atlas_buffer_overlaps(source_front, source_x, source_y, width, height)
+        && atlas_buffer_idle(target_back)
+        && atlas_texture_copy(source_front->texture, source_x, source_y, target_back->texture, x, y, width, height))
+    {
+        atlas_buffer_add_pending(target_front, x, y, width, height);
+        return;
+    }
+
+    atlas_page_invalidate(target, x, y, width, height);
+}
+
+/**
+ * Packs a bitmap into the first page of its format with room for it,
+ * plots emptied by removed glyphs included, the textures receive it from atlas_publish.
+ * Under a budget, glyphs are evicted before a page is added past it,
+ * the budget is only exceeded when nothing can be evicted.
+ * Texels are atlas_get_channels(format) bytes and rows are `pitch` bytes apart.
+ * Returns 0 if the bitmap is larger than a plot.
+ */
+int atlas_add(int format, int width, int height, int pitch, const unsigned char* pixels, atlas_region_T* region)
+{
+    // Blank glyphs such as spaces take no room in the atlas
+    if (width == 0 || height == 0)
+    {
+        memset(region, 0, sizeof(struct ATLAS_REGION_STRUCT));
+        return 1;
+    }
+
+    int padded_width = width + ATLAS_PADDING * 2;
+    int padded_height = height + ATLAS_PADDING * 2;
+
+    if (padded_width > ATLAS_PLOT_SIZE || padded_height > ATLAS_PLOT_SIZE)
+    {
+        perror("ERROR::ATLAS: Glyph does not fit in an atlas plot");
+        return 0;
+    }
+
+    int x = 0;
+    int y = 0;
+    unsigned int index = 0;
+    size_t page_bytes = atlas_page_bytes(format, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+
+    while (!atlas_place(format, padded_width, padded_height, &index, &x, &y))
+    {
+        int within_budget = budget == ATLAS_BUDGET_UNLIMITED || bytes + page_bytes <= budget;
+
+        // Evicting empties a plot, which may or may not leave the room needed
+        if (within_budget || evict == (void*)0 || evict(format) == 0)
+        {
+            index = atlas_page_new(format, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+            atlas_page_insert(pages[index], padded_width, padded_height, &x, &y);
+            break;
+        }
+    }
+
+    region->page = index;
+    region->x = x + ATLAS_PADDING;
+    region->y = y + ATLAS_PADDING;
+    region->width = width;
+    region->height = height;
+
+    // Keep the CPU copy in sync, the GPU texture cannot be read back cheaply
+    atlas_page_T* page = pages[index];
+    int channels = atlas_get_channels(format);
+    for (int row = 0; row < height; row++)
+    {
+        memcpy(
+            &page->pixels[((size_t)(region->y + row) * page->width + region->x) * channels],
+            &pixels[(size_t)row * pitch],
+            (size_t)width * channels
+        );
+    }
+
+    atlas_page_invalidate(page, region->x, region->y, width, height);
+
+    return 1;
+}
+
+/**
+ * Once the glyphs on the sparsest pages of a format fit into a single page
+ * filled to ATLAS_REPACK_FILL, starts moving them into a new page of their own.
+ * The drained pages are released, two or more pages become one, each of them
+ * a texture bind and a draw call less.
+ * Returns the page being packed into, or -1 when no repack is running or worth it.
+ */
+int atlas_begin_repack()
+{
+    if (repack_target >= 0 || repack_blocked)
+        return repack_target;
+
+    size_t limit = ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * ATLAS_REPACK_FILL;
+
+    for (int format = ATLAS_FORMAT_COVERAGE; format <= ATLAS_FORMAT_MSDF; format++)
+    {
+        size_t count = 0;
+        size_t area = 0;
+
+        // Take the sparsest pages one by one while their glyphs still fit
+        while (1)
+        {
+            int sparsest = -1;
+
+            for (unsigned int i = 0; i < pages_size; i++)
+            {
+                // Empty pages draw nothing and are filled again before new ones are added
+                if (pages[i]->plots == (void*)0 || pages[i]->format != format || pages[i]->repacking || pages[i]->glyphs == 0)
+                    continue;
+
+                if (sparsest < 0 || pages[i]->area < pages[sparsest]->area)
+                    sparsest = i;
+            }
+
+            if (sparsest < 0 || area + pages[sparsest]->area > limit)
+                break;
+
+            pages[sparsest]->repacking = 1;
+            area += pages[sparsest]->area;
+            count += 1;
+        }
+
+        if (count >= 2)
+        {
+            repack_target = atlas_page_new(format, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+            return repack_target;
+        }
+
+        for (unsigned int i = 0; i < pages_size; i++)
+            pages[i]->repacking = 0;
+    }
+
+    return -1;
+}
+
+/**
+ * Stops a running repack until pages are added or released,
+ * the pages being drained keep the glyphs that were not moved yet.
+ */
+void atlas_cancel_repack()
+{
+    if (repack_target < 0)
+        return;
+
+    for (unsigned int i = 0; i < pages_size; i++)
+        pages[i]->repacking = 0;
+
+    repack_target = -1;
+    repack_blocked = 1;
+}
+
+/**
+ * Moves a glyph off a page being repacked into the page packed into
+ * and removes it from its old place, which releases the old page once it is empty.
+ * Returns 0 and stops the repack when the new page has no room left for it.
+ */
+int atlas_move(const atlas_region_T* from, atlas_region_T* to)
+{
+    atlas_page_T* source = pages[from->page];
+    atlas_page_T* target = pages[repack_target];
+    int x = 0;
+    int y = 0;
+
+    if (!atlas_page_insert(target, from->width + ATLAS_PADDING * 2, from->height + ATLAS_PADDING * 2, &x, &y))
+    {
+        atlas_cancel_repack();
+        return 0;
+    }
+
+    to->page = repack_target;
+    to->x = x + ATLAS_PADDING;
+    to->y = y + ATLAS_PADDING;
+    to->width = from->width;
+    to->height = from->height;
+
+    atlas_page_copy(source, from->x, from->y, target, to->x, to->y, to->width, to->height);
+
+    relocations += 1;
+    source->relocated = relocations;
+    atlas_remove(from);
+
+    return 1;
+}
+
+/**
+ * Counts the glyphs moved by repacking and the pages released so far.
+ * Layouts made with glyphs of a page whose `relocated` is newer must be made again.
+ */
+unsigned long atlas_get_relocations()
+{
+    return relocations;
+}
+
+/**
+ * Returns the plot a glyph was packed into, counted across all pages.
+ */
+unsigned int atlas_get_plot(const atlas_region_T* region)
+{
+    int plots_per_row = ATLAS_PAGE_SIZE / ATLAS_PLOT_SIZE;
+
+    return region->page * ATLAS_PAGE_PLOTS
+        + (region->y / ATLAS_PLOT_SIZE) * plots_per_row
+        + region->x / ATLAS_PLOT_SIZE;
+}
+
+/**
+ * Clears the texels of a glyph. A plot left without glyphs starts over empty,
+ * a page left without glyphs is released while the atlas is over its budget.
+ * Glyphs of fixed pages stay where they are.
+ */
+void atlas_remove(const atlas_region_T* region)
+{
+    if (region->width == 0 || region->height == 0 || region->page >= pages_size)
+        return;
+
+    atlas_page_T* page = pages[region->page];
+
+    if (page->plots == (void*)0)
+        return;
+
+    int channels = atlas_get_channels(page->format);
+    for (int row = 0; row < region->height; row++)
+    {
+        memset(
+            &page->pixels[((size_t)(region->y + row) * page->width + region->x) * channels],
+            0,
+            (size_t)region->width * channels
+        );
+    }
+
+    atlas_plot_T* plot = &page->plots[atlas_get_plot(region) - region->page * ATLAS_PAGE_PLOTS];
+    plot->glyphs -= 1;
+    page->glyphs -= 1;
+    page->area -= (size_t)(region->width + ATLAS_PADDING * 2) * (region->height + ATLAS_PADDING * 2);
+
+    if (plot->glyphs == 0)
+        atlas_plot_reset(plot);
+
+    if (page->glyphs == 0 && page->repacking)
+    {
+        atlas_page_release(page);
+
+        int draining = 0;
+        for (unsigned int i = 0; i < pages_size; i++)
+            draining |= pages[i]->repacking;
+
+        // Everything was moved, the new page takes glyphs like any other
+        if (!draining)
+            repack_target = -1;
+
+        return;
+    }
+
+    if (page->glyphs == 0 && budget != ATLAS_BUDGET_UNLIMITED && bytes > budget)
+    {
+        atlas_page_release(page);
+        return;
+    }
+
+    // Filtering and the padding of the next glyph placed here must read as empty
+    atlas_page_invalidate(page, region->x, region->y, region->width, region->height);
+}
+
+/**
+ * Rows of a page down to the lowest glyph, the rest of it is empty.
+ */
+int atlas_get_used_height(atlas_page_T* page)
+{
+    if (page->plots == (void*)0)
+        return page->height;
+
+    int plots_per_row = page->width / ATLAS_PLOT_SIZE;
+    int height = 0;
+
+    for (size_t i = 0; i < ATLAS_PAGE_PLOTS; i++)
+    {
+        atlas_plot_T* plot = &page->plots[i];
+        int plot_y = (i / plots_per_row) * ATLAS_PLOT_SIZE;
+
+        for (size_t n = 0; n < plot->nodes_size; n++)
+        {
+            if (plot->nodes[n].y > 0 && plot_y + plot->nodes[n].y > height)
+                height = plot_y + plot->nodes[n].y;
+        }
+    }
+
+    return height;
+}
+
+/**
+ * Limits the texture memory of the pages to `limit` bytes, ATLAS_BUDGET_UNLIMITED for no limit.
+ * `evict_callback` is called with a page format when a glyph of it does not fit,
+ * it should remove glyphs of that format with atlas_remove and return how many it removed.
+ */
+void atlas_set_budget(size_t limit, int (*evict_callback)(int format))
+{
+    budget = limit;
+    evict = evict_callback;
+}
+
+/**
+ * Texture memory of all live pages, fixed ones included: the front and back texture
+ * of every page at width * height * atlas_get_channels bytes each.
+ * The CPU copies take half as much again on top, headless pages are counted the same.
+ */
+size_t atlas_get_bytes()
+{
+    return bytes;
+}
+
+/**
+ * Adds a page that was packed ahead of time, such as a baked one.
+ * Nothing else is packed into it afterwards and its glyphs are never removed.
+ * Returns the index of the page.
+ */
+unsigned int atlas_add_page(int width, int height, const unsigned char* pixels)
+{
+    atlas_page_T* page = calloc(1, sizeof(struct ATLAS_PAGE_STRUCT));
+    page->format = ATLAS_FORMAT_COVERAGE;
+    page->width = width;
+    page->height = height;
+    page->fixed = 1;
+    page->pixels = malloc((size_t)width * height);
+    memcpy(page->pixels, pixels, (size_t)width * height);
+
+    if (!headless)
+        atlas_page_create_texture(page);
+
+    return atlas_store_page(page);
+}
+
+/**
+ * Makes every glyph added so far visible to the draws issued after this call.
+ * A page's changes are uploaded into its back texture, which then becomes the front one,
+ * so draws still in flight keep sampling a texture nobody writes.
+ * When the GPU still reads the back texture as well the front one is updated instead,
+ * leaving it to the driver to order the upload after those draws.
+ * While the upload thread runs, the back texture is filled there and only swapped in
+ * by a later call once its fence signaled, new glyphs show up a frame or two late
+ * and the render thread only writes texels for glyphs moved by repacking, see atlas_page_copy.
+ * Call on the thread owning the OpenGL context before drawing text.
+ */
+void atlas_publish()
+{
+    if (headless)
+        return;
+
+    for (size_t i = 0; i < pages_size; i++)
+    {
+        atlas_page_T* page = pages[i];
+
+        if (page->pixels == (void*)0)
+            continue;
+
+        if (!atlas_page_take_upload(page, 0))
+            continue;
+
+        atlas_buffer_T* back = &page->buffers[!page->front];
+
+        if (page->buffers[page->front].pending_size == 0)
+            continue;
+
+        if (atlas_buffer_idle(back))
+        {
+            if (upload_thread_running())
+            {
+                atlas_buffer_submit(page, back);
+            }
+            else
+            {
+                atlas_buffer_upload(page, back);
+                page->front = !page->front;
+            }
+        }
+        else if (!upload_thread_running())
+        {
+            atlas_buffer_upload(page, &page->buffers[page->front]);
+        }
+    }
+}
+
+/**
+ * Fences the front textures after the last draw sampling them this frame.
+ * Call once per frame after drawing text.
+ */
+void atlas_end_frame()
+{
+    if (headless)
+        return;
+
+    for (size_t i = 0; i < pages_size; i++)
+    {
+        atlas_page_T* page = pages[i];
+
+        if (page->pixels == (void*)0)
+            continue;
+
+        atlas_buffer_T* front = &page->buffers[page->front];
+
+        if (front->fence)
+            glDeleteSync(front->fence);
+
+        front->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    if (staging != (void*)0)
+        stream_buffer_end_frame(staging);
+}
+
+/**
+ * The texture draws sample the page from.
+ */
+GLuint atlas_get_texture(atlas_page_T* page)
+{
+    return page->buffers[page->front].texture;
+}
+
+atlas_page_T* atlas_get_page(unsigned int index)
+{
+    return index < pages_size ? pages[index] : (void*)0;
+}
+
+size_t atlas_get_page_count()
+{
+    return pages_size;
+}
+
+void atlas_free()
+{
+    for (size_t i = 0; i < pages_size; i++)
+    {
+        atlas_page_delete_textures(pages[i]);
+        free(pages[i]->pixels);
+        atlas_page_free_plots(pages[i]);
+        free(pages[i]);
+    }
+
+    if (!headless && repack_framebuffers[0] != 0)
+    {
+        glDeleteFramebuffers(2, repack_framebuffers);
+        memset(repack_framebuffers, 0, sizeof(repack_framebuffers));
+    }
+
+    if (staging != (void*)0)
+    {
+        stream_buffer_free(staging);
+        staging = (void*)0;
+    }
+
+    // Buffer objects are shared, the jobs using it were released with the textures above
+    if (upload_staging != (void*)0)
+    {
+        stream_buffer_free(upload_staging);
+        upload_staging = (void*)0;
+    }
+
+    free(pages);
+    pages = (void*)0;
+    pages_size = 0;
+    bytes = 0;
+    repack_target = -1;
+    repack_blocked = 0;
+}
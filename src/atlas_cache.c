@@ -0,0 +1,240 @@
+#include "include/atlas_cache.h"
+#include "include/glyph_cache.h"
+#include "include/atlas.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+static void atlas_cache_path(font_T* font, const char* directory, char* path, size_t path_size)
+{
+    snprintf(
+        path,
+        path_size,
+        "%s/%016llx-%ld-%d-%d.glyphs",
+        directory,
+        (unsigned long long) font_get_file_hash(font),
+        font->face->index,
+        font->pixel_size,
+        font->mode
+    );
+}
+
+static void atlas_cache_fill_header(font_T* font, atlas_cache_header_T* header, uint32_t glyphs_size)
+{
+    memset(header, 0, sizeof(struct ATLAS_CACHE_HEADER_STRUCT));
+    memcpy(header->magic, ATLAS_CACHE_MAGIC, 4);
+    header->version = ATLAS_CACHE_VERSION;
+    header->font_hash = font_get_file_hash(font);
+    header->face_index = font->face->index;
+    header->pixel_size = font->pixel_size;
+    header->mode = font->mode;
+    header->load_flags = character_get_load_flags(font);
+    header->glyphs_size = glyphs_size;
+    header->byte_order = ATLAS_CACHE_BYTE_ORDER;
+}
+
+/**
+ * $XDG_CACHE_HOME/fontgl, or ~/.cache/fontgl, created if missing.
+ * Returns a null pointer when neither variable is set.
+ */
+const char* atlas_cache_get_directory()
+{
+    static char directory[4096 + 8];
+
+    if (directory[0] != 0)
+        return directory;
+
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    char parent[4096];
+
+    if (xdg != (void*)0 && xdg[0] != 0)
+        snprintf(parent, sizeof(parent), "%s", xdg);
+    else if (home != (void*)0 && home[0] != 0)
+        snprintf(parent, sizeof(parent), "%s/.cache", home);
+    else
+        return (void*)0;
+
+    mkdir(parent, 0755);
+    snprintf(directory, sizeof(directory), "%s/fontgl", parent);
+    mkdir(directory, 0755);
+
+    return directory;
+}
+
+/**
+ * Adds every glyph stored in the font's cache file without touching FreeType,
+ * the bitmaps are uploaded straight out of the mapped file.
+ * Files of another font version, size, mode, format or byte order are ignored.
+ * Returns the amount of glyphs loaded.
+ */
+size_t atlas_cache_load(font_T* font, const char* directory)
+{
+    if (directory == (void*)0 || font->face == (void*)0)
+        return 0;
+
+    char path[4096];
+    atlas_cache_path(font, directory, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(struct ATLAS_CACHE_HEADER_STRUCT))
+    {
+        close(fd);
+        return 0;
+    }
+
+    size_t file_size = st.st_size;
+    const unsigned char* data = mmap((void*)0, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        perror("ERROR::ATLAS_CACHE: Failed to map cache file");
+        return 0;
+    }
+
+    atlas_cache_header_T expected;
+    atlas_cache_header_T header;
+    memcpy(&header, data, sizeof(struct ATLAS_CACHE_HEADER_STRUCT));
+    atlas_cache_fill_header(font, &expected, header.glyphs_size);
+
+    size_t loaded = 0;
+    size_t records_end = sizeof(struct ATLAS_CACHE_HEADER_STRUCT)
+        + (size_t) header.glyphs_size * sizeof(struct ATLAS_CACHE_GLYPH_STRUCT);
+
+    // A stale or foreign file is simply not used, the next save replaces it
+    if (memcmp(&header, &expected, sizeof(struct ATLAS_CACHE_HEADER_STRUCT)) != 0 || records_end > file_size)
+    {
+        munmap((void*) data, file_size);
+        return 0;
+    }
+
+    const atlas_cache_glyph_T* glyphs = (const atlas_cache_glyph_T*) (data + sizeof(struct ATLAS_CACHE_HEADER_STRUCT));
+    int format = character_get_format(font);
+    int channels = atlas_get_channels(format);
+
+    for (uint32_t i = 0; i < header.glyphs_size; i++)
+    {
+        const atlas_cache_glyph_T* glyph = &glyphs[i];
+        size_t bytes = (size_t) glyph->width * glyph->height * channels;
+
+        if (glyph->offset < records_end || glyph->offset + bytes > file_size)
+        {
+            perror("ERROR::ATLAS_CACHE: Corrupt cache file");
+            break;
+        }
+
+        glyph_bitmap_T bitmap;
+        bitmap.pixels = data + glyph->offset;
+        bitmap.width = glyph->width;
+        bitmap.rows = glyph->height;
+        bitmap.pitch = glyph->width * channels;
+        bitmap.format = format;
+        bitmap.bearing_left = glyph->bearing_left;
+        bitmap.bearing_top = glyph->bearing_top;
+        bitmap.advance = glyph->advance;
+
+        glyph_cache_insert(font, glyph->codepoint, add_character(&bitmap));
+        loaded += 1;
+    }
+
+    munmap((void*) data, file_size);
+
+    return loaded;
+}
+
+/**
+ * Writes every glyph cached for the font, replacing its previous cache file.
+ * The file is written next to the old one and renamed over it,
+ * so a concurrent load never sees a partial file.
+ * Returns 0 on failure.
+ */
+int atlas_cache_save(font_T* font, const char* directory)
+{
+    if (directory == (void*)0 || font->face == (void*)0)
+        return 0;
+
+    size_t count = glyph_cache_list(font, (void*)0, (void*)0, 0);
+    uint32_t* codepoints = malloc(sizeof(uint32_t) * (count + 1));
+    glyph_id_T* ids = malloc(sizeof(glyph_id_T) * (count + 1));
+    glyph_cache_list(font, codepoints, ids, count);
+
+    atlas_cache_glyph_T* glyphs = calloc(count + 1, sizeof(struct ATLAS_CACHE_GLYPH_STRUCT));
+    glyph_store_T* store = glyph_store_get();
+    int channels = atlas_get_channels(character_get_format(font));
+    size_t offset = sizeof(struct ATLAS_CACHE_HEADER_STRUCT) + count * sizeof(struct ATLAS_CACHE_GLYPH_STRUCT);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        glyph_id_T id = ids[i];
+
+        glyphs[i].codepoint = codepoints[i];
+        glyphs[i].offset = offset;
+        glyphs[i].advance = store->advance[id];
+        glyphs[i].bearing_left = store->bearing_left[id];
+        glyphs[i].bearing_top = store->bearing_top[id];
+        glyphs[i].width = store->width[id];
+        glyphs[i].height = store->height[id];
+
+        offset += (size_t) glyphs[i].width * glyphs[i].height * channels;
+    }
+
+    char path[4096];
+    char temporary[4096 + 16];
+    atlas_cache_path(font, directory, path, sizeof(path));
+    snprintf(temporary, sizeof(temporary), "%s.%d", path, (int) getpid());
+
+    FILE* file = fopen(temporary, "wb");
+    int success = file != (void*)0;
+
+    if (success)
+    {
+        atlas_cache_header_T header;
+        atlas_cache_fill_header(font, &header, count);
+
+        success = fwrite(&header, sizeof(struct ATLAS_CACHE_HEADER_STRUCT), 1, file) == 1;
+        success = success && fwrite(glyphs, sizeof(struct ATLAS_CACHE_GLYPH_STRUCT), count, file) == count;
+
+        // Bitmaps are copied out of the CPU side of the atlas
+        for (size_t i = 0; success && i < count; i++)
+        {
+            glyph_id_T id = ids[i];
+            atlas_page_T* page = atlas_get_page(store->page[id]);
+
+            size_t row_size = (size_t) glyphs[i].width * channels;
+
+            for (int row = 0; success && row < glyphs[i].height; row++)
+            {
+                size_t start = ((size_t)(store->atlas_y[id] + row) * page->width + store->atlas_x[id]) * channels;
+                success = fwrite(&page->pixels[start], 1, row_size, file) == row_size;
+            }
+        }
+
+        success = (fclose(file) == 0) && success;
+    }
+
+    if (success)
+        success = rename(temporary, path) == 0;
+
+    if (!success)
+    {
+        perror("ERROR::ATLAS_CACHE: Failed to write cache file");
+        unlink(temporary);
+    }
+
+    free(codepoints);
+    free(ids);
+    free(glyphs);
+
+    return success;
+}
@@ -0,0 +1,201 @@
+#include "include/baked.h"
+#include "include/glyph_cache.h"
+#include "include/metrics.h"
+#include "include/atlas.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/**
+ * Uploads the pages of baked data and creates its fonts, FreeType is never used.
+ * `data` is only read during the call and needs no alignment, a generated C array can be passed directly.
+ * Returns a null pointer if the data is not valid.
+ */
+baked_atlas_T* baked_load(const unsigned char* data, size_t size)
+{
+    baked_header_T header;
+
+    if (size < sizeof(struct BAKED_HEADER_STRUCT))
+    {
+        perror("ERROR::BAKED: Data too small");
+        return (void*)0;
+    }
+
+    memcpy(&header, data, sizeof(struct BAKED_HEADER_STRUCT));
+
+    if (memcmp(header.magic, BAKED_MAGIC, 4) != 0 || header.version != BAKED_VERSION)
+    {
+        perror("ERROR::BAKED: Not baked data of this version");
+        return (void*)0;
+    }
+
+    size_t fonts_offset = sizeof(struct BAKED_HEADER_STRUCT);
+    size_t glyphs_offset = fonts_offset + (size_t) header.fonts_size * sizeof(struct BAKED_FONT_STRUCT);
+    size_t pages_offset = glyphs_offset + (size_t) header.glyphs_size * sizeof(struct BAKED_GLYPH_STRUCT);
+    size_t page_bytes = (size_t) header.page_width * header.page_height;
+
+    if (pages_offset + page_bytes * header.pages_size > size)
+    {
+        perror("ERROR::BAKED: Data truncated");
+        return (void*)0;
+    }
+
+    // Generated arrays are only byte aligned, every record is copied out before it is read
+    const unsigned char* infos = data + fonts_offset;
+    const unsigned char* glyphs = data + glyphs_offset;
+
+    for (uint32_t i = 0; i < header.fonts_size; i++)
+    {
+        baked_font_T info;
+        memcpy(&info, infos + sizeof(struct BAKED_FONT_STRUCT) * i, sizeof(struct BAKED_FONT_STRUCT));
+
+        if ((size_t) info.glyphs_start + info.glyphs_size > header.glyphs_size)
+        {
+            perror("ERROR::BAKED: Font glyphs out of range");
+            return (void*)0;
+        }
+    }
+
+    for (uint32_t i = 0; i < header.glyphs_size; i++)
+    {
+        baked_glyph_T glyph;
+        memcpy(&glyph, glyphs + sizeof(struct BAKED_GLYPH_STRUCT) * i, sizeof(struct BAKED_GLYPH_STRUCT));
+
+        // Blank glyphs take no room in any page
+        if (glyph.width == 0 || glyph.height == 0)
+            continue;
+
+        if (glyph.page >= header.pages_size
+            || (uint32_t) glyph.atlas_x + glyph.width > header.page_width
+            || (uint32_t) glyph.atlas_y + glyph.height > header.page_height)
+        {
+            perror("ERROR::BAKED: Glyph out of its page");
+            return (void*)0;
+        }
+    }
+
+    // Baked page indices are relative to the first page added here
+    unsigned int first_page = atlas_get_page_count();
+
+    for (uint32_t i = 0; i < header.pages_size; i++)
+        atlas_add_page(header.page_width, header.page_height, data + pages_offset + page_bytes * i);
+
+    baked_atlas_T* atlas = calloc(1, sizeof(struct BAKED_ATLAS_STRUCT));
+    atlas->fonts_size = header.fonts_size;
+    atlas->fonts = calloc(header.fonts_size, sizeof(struct FONT_STRUCT*));
+    atlas->infos = malloc(sizeof(struct BAKED_FONT_STRUCT) * header.fonts_size);
+    memcpy(atlas->infos, infos, sizeof(struct BAKED_FONT_STRUCT) * header.fonts_size);
+
+    for (size_t i = 0; i < atlas->fonts_size; i++)
+    {
+        baked_font_T* info = &atlas->infos[i];
+        info->name[BAKED_NAME_SIZE - 1] = 0;
+
+        font_T* font = font_new_baked(info->pixel_size, info->line_height);
+        atlas->fonts[i] = font;
+
+        for (uint32_t j = info->glyphs_start; j < info->glyphs_start + info->glyphs_size; j++)
+        {
+            baked_glyph_T glyph;
+            memcpy(&glyph, glyphs + sizeof(struct BAKED_GLYPH_STRUCT) * j, sizeof(struct BAKED_GLYPH_STRUCT));
+
+            glyph_id_T id = glyph_store_add();
+            glyph_store_T* store = glyph_store_get();
+            store->page[id] = first_page + glyph.page;
+            store->atlas_x[id] = glyph.atlas_x;
+            store->atlas_y[id] = glyph.atlas_y;
+            store->width[id] = glyph.width;
+            store->height[id] = glyph.height;
+            store->bearing_left[id] = glyph.bearing_left;
+            store->bearing_top[id] = glyph.bearing_top;
+            store->advance[id] = glyph.advance;
+
+            glyph_cache_insert(font, glyph.codepoint, id);
+
+            // Measuring works the same as for fonts opened with FreeType
+            glyph_metrics_T metrics;
+            metrics.advance = glyph.advance << 6;
+            metrics.bearing_left = glyph.bearing_left;
+            metrics.bearing_top = glyph.bearing_top;
+            metrics.width = glyph.width;
+            metrics.height = glyph.height;
+            metrics_set_glyph(font, glyph.codepoint, metrics);
+        }
+    }
+
+    return atlas;
+}
+
+baked_atlas_T* baked_load_file(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        perror("ERROR::BAKED: Failed to open baked file");
+        return (void*)0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        perror("ERROR::BAKED: Failed to stat baked file");
+        close(fd);
+        return (void*)0;
+    }
+
+    void* data = mmap((void*)0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        perror("ERROR::BAKED: Failed to map baked file");
+        return (void*)0;
+    }
+
+    baked_atlas_T* atlas = baked_load(data, st.st_size);
+    munmap(data, st.st_size);
+
+    return atlas;
+}
+
+/**
+ * Returns the baked font with the given file name and pixel size,
+ * a null name or a size of 0 matches any.
+ * Every returned font must be released with font_close.
+ */
+font_T* baked_find_font(baked_atlas_T* atlas, const char* name, int pixel_size)
+{
+    for (size_t i = 0; i < atlas->fonts_size; i++)
+    {
+        baked_font_T* info = &atlas->infos[i];
+
+        if (name != (void*)0 && strcmp(info->name, name) != 0)
+            continue;
+
+        if (pixel_size != 0 && info->pixel_size != pixel_size)
+            continue;
+
+        return font_retain(atlas->fonts[i]);
+    }
+
+    return (void*)0;
+}
+
+/**
+ * Releases the fonts of the atlas, its pages stay in the atlas until atlas_free.
+ */
+void baked_free(baked_atlas_T* atlas)
+{
+    for (size_t i = 0; i < atlas->fonts_size; i++)
+        font_close(atlas->fonts[i]);
+
+    free(atlas->fonts);
+    free(atlas->infos);
+    free(atlas);
+}
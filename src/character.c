@@ -0,0 +1,231 @@
+#include "include/character.h"
+#include "include/glyph_cache.h"
+#include "include/atlas.h"
+#include "include/utf8.h"
+#include "include/sdf.h"
+#include "include/msdf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * The atlas format glyphs of a font are stored in.
+ */
+int character_get_format(font_T* font)
+{
+    if (font->mode == FONT_MODE_MSDF)
+        return ATLAS_FORMAT_MSDF;
+
+    return font->mode == FONT_MODE_SDF ? ATLAS_FORMAT_SDF : ATLAS_FORMAT_COVERAGE;
+}
+
+/**
+ * Flags to load glyphs of a font with before character_convert.
+ */
+int character_get_load_flags(font_T* font)
+{
+    // Multi-channel fields are computed from the outline itself
+    return font->mode == FONT_MODE_MSDF ? CHARACTER_OUTLINE_LOAD_FLAGS : CHARACTER_LOAD_FLAGS;
+}
+
+/**
+ * Generates the multi-channel distance field of an outline loaded into a slot,
+ * placed on the pixel grid the rasterizer would have used.
+ */
+static unsigned char* character_convert_outline(FT_GlyphSlot slot, glyph_bitmap_T* bitmap)
+{
+    FT_BBox box;
+    FT_Outline_Get_CBox(&slot->outline, &box);
+
+    // Grid fit the same way the rasterizer does
+    box.xMin &= ~63;
+    box.yMin &= ~63;
+    box.xMax = (box.xMax + 63) & ~63;
+    box.yMax = (box.yMax + 63) & ~63;
+
+    int width = (box.xMax - box.xMin) >> 6;
+    int rows = (box.yMax - box.yMin) >> 6;
+
+    bitmap->advance = slot->advance.x >> 6;
+
+    // Blank glyphs have no outline to measure distances to
+    if (slot->outline.n_points == 0 || width == 0 || rows == 0)
+    {
+        bitmap->pixels = (void*)0;
+        bitmap->width = 0;
+        bitmap->rows = 0;
+        bitmap->pitch = 0;
+        bitmap->bearing_left = 0;
+        bitmap->bearing_top = 0;
+
+        return (void*)0;
+    }
+
+    unsigned char* field = msdf_generate(&slot->outline, box.xMin >> 6, box.yMax >> 6, width, rows, MSDF_SPREAD);
+
+    bitmap->pixels = field;
+    bitmap->width = width + MSDF_SPREAD * 2;
+    bitmap->rows = rows + MSDF_SPREAD * 2;
+    bitmap->pitch = bitmap->width * 3;
+    bitmap->bearing_left = (box.xMin >> 6) - MSDF_SPREAD;
+    bitmap->bearing_top = (box.yMax >> 6) + MSDF_SPREAD;
+
+    return field;
+}
+
+/**
+ * Describes the glyph loaded into a slot in the font's atlas format,
+ * the slot must have been loaded with character_get_load_flags.
+ * Fonts in FONT_MODE_SDF get a distance field with SDF_SPREAD texels around the outline
+ * and fonts in FONT_MODE_MSDF a multi-channel one with MSDF_SPREAD texels,
+ * which is returned and must be freed by the caller.
+ * Otherwise a null pointer is returned and the bitmap points into the slot,
+ * only valid until the next glyph is loaded into it.
+ */
+unsigned char* character_convert(font_T* font, FT_GlyphSlot slot, glyph_bitmap_T* bitmap)
+{
+    bitmap->format = character_get_format(font);
+
+    if (font->mode == FONT_MODE_MSDF && slot->format == FT_GLYPH_FORMAT_OUTLINE)
+        return character_convert_outline(slot, bitmap);
+
+    bitmap->pixels = slot->bitmap.buffer;
+    bitmap->width = slot->bitmap.width;
+    bitmap->rows = slot->bitmap.rows;
+    bitmap->pitch = slot->bitmap.pitch;
+    bitmap->bearing_left = slot->bitmap_left;
+    bitmap->bearing_top = slot->bitmap_top;
+    bitmap->advance = slot->advance.x >> 6;
+
+    // Blank glyphs have no outline to measure distances to
+    if (font->mode == FONT_MODE_BITMAP || bitmap->width == 0 || bitmap->rows == 0)
+        return (void*)0;
+
+    int spread = font->mode == FONT_MODE_MSDF ? MSDF_SPREAD : SDF_SPREAD;
+    int channels = atlas_get_channels(bitmap->format);
+    unsigned char* field = sdf_generate(bitmap->pixels, bitmap->width, bitmap->rows, bitmap->pitch, spread);
+
+    bitmap->width += spread * 2;
+    bitmap->rows += spread * 2;
+    bitmap->pitch = bitmap->width * channels;
+    bitmap->bearing_left -= spread;
+    bitmap->bearing_top += spread;
+
+    // Glyphs without an outline, such as those of bitmap fonts, get the same field in every channel
+    if (channels > 1)
+    {
+        size_t size = (size_t) bitmap->width * bitmap->rows;
+        unsigned char* texels = malloc(size * channels);
+
+        for (size_t i = 0; i < size; i++)
+            memset(&texels[i * channels], field[i], channels);
+
+        free(field);
+        field = texels;
+    }
+
+    bitmap->pixels = field;
+
+    return field;
+}
+
+/**
+ * Packs a rendered glyph into the atlas and records it in the glyph store.
+ * Must be called on the thread owning the OpenGL context.
+ */
+glyph_id_T add_character(glyph_bitmap_T* bitmap)
+{
+    // Pack the glyph into the atlas
+    atlas_region_T region;
+    if (!atlas_add(bitmap->format, bitmap->width, bitmap->rows, bitmap->pitch, bitmap->pixels, &region))
+        memset(&region, 0, sizeof(struct ATLAS_REGION_STRUCT));
+
+    // Now store character for later use
+    glyph_id_T id = glyph_store_add();
+    glyph_store_T* store = glyph_store_get();
+    store->page[id] = region.page;
+    store->atlas_x[id] = region.x;
+    store->atlas_y[id] = region.y;
+    store->width[id] = region.width;
+    store->height[id] = region.height;
+    store->bearing_left[id] = bitmap->bearing_left;
+    store->bearing_top[id] = bitmap->bearing_top;
+    store->advance[id] = bitmap->advance;
+
+    return id;
+}
+
+/**
+ * Rasterizes a glyph on the calling thread and adds it.
+ */
+glyph_id_T get_character(font_T* font, uint32_t codepoint)
+{
+    FT_Face face = font_lock(font);
+
+    // Load character glyph 
+    if (FT_Load_Char(face, codepoint, character_get_load_flags(font)))
+        perror("ERROR::FREETYTPE: Failed to load Glyph");
+
+    glyph_bitmap_T bitmap;
+    unsigned char* converted = character_convert(font, face->glyph, &bitmap);
+
+    glyph_id_T id = add_character(&bitmap);
+
+    font_unlock(font);
+    free(converted);
+
+    return id;
+}
+
+glyph_run_T get_characters(const char* text, font_T* font)
+{
+    glyph_run_T run;
+    run.size = 0;
+    run.capacity = 0;
+    run.ids = (void*)0;
+
+    glyph_run_fill(&run, text, font);
+
+    return run;
+}
+
+/**
+ * Replaces the contents of the run with the glyphs of a UTF-8 string,
+ * growing it geometrically so refilling does not allocate in steady state.
+ */
+void glyph_run_fill(glyph_run_T* run, const char* text, font_T* font)
+{
+    size_t length = strlen(text);
+
+    // The byte length bounds the amount of codepoints
+    if (length > run->capacity)
+    {
+        size_t capacity = run->capacity ? run->capacity : 16;
+
+        while (capacity < length)
+            capacity *= 2;
+
+        run->ids = realloc(run->ids, sizeof(glyph_id_T) * capacity);
+        run->capacity = capacity;
+    }
+
+    // Codepoints are decoded in place and then replaced by their glyphs
+    run->size = utf8_decode_string(text, length, run->ids);
+
+    for (size_t i = 0; i < run->size; i++)
+        run->ids[i] = glyph_cache_get(font, run->ids[i]);
+}
+
+void glyph_run_clear(glyph_run_T* run)
+{
+    run->size = 0;
+}
+
+void glyph_run_free(glyph_run_T* run)
+{
+    free(run->ids);
+    run->ids = (void*)0;
+    run->size = 0;
+    run->capacity = 0;
+}
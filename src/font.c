@@ -0,0 +1,443 @@
+#include "include/font.h"
+#include "include/glyph_cache.h"
+#include "include/metrics.h"
+#include "include/raster_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/**
+ * One FreeType library for the whole process,
+ * created on the first font_open and destroyed when the last font is closed.
+ */
+static FT_Library library = (void*)0;
+
+static font_file_T** files = (void*)0;
+static size_t files_size = 0;
+
+static font_face_T** faces = (void*)0;
+static size_t faces_size = 0;
+
+static font_T** fonts = (void*)0;
+static size_t fonts_size = 0;
+
+FT_Library font_get_library()
+{
+    if (library == (void*)0)
+    {
+        // All functions return a value different than 0 whenever an error occurred
+        if (FT_Init_FreeType(&library))
+        {
+            perror("ERROR::FREETYPE: Could not init FreeType Library");
+            library = (void*)0;
+        }
+    }
+
+    return library;
+}
+
+/**
+ * Maps a font file read only, or returns the existing mapping of it.
+ */
+static font_file_T* font_file_open(const char* path)
+{
+    for (size_t i = 0; i < files_size; i++)
+    {
+        if (strcmp(files[i]->path, path) == 0)
+        {
+            files[i]->refcount += 1;
+            return files[i];
+        }
+    }
+
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        perror("ERROR::FONT: Failed to open font file");
+        return (void*)0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        perror("ERROR::FONT: Failed to stat font file");
+        close(fd);
+        return (void*)0;
+    }
+
+    void* data = mmap((void*)0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        perror("ERROR::FONT: Failed to map font file");
+        return (void*)0;
+    }
+
+    font_file_T* file = calloc(1, sizeof(struct FONT_FILE_STRUCT));
+    file->path = strdup(path);
+    file->data = data;
+    file->size = st.st_size;
+    file->modified = st.st_mtime;
+    file->inode = st.st_ino;
+    file->refcount = 1;
+
+    files_size += 1;
+    files = realloc(files, sizeof(struct FONT_FILE_STRUCT*) * files_size);
+    files[files_size - 1] = file;
+
+    return file;
+}
+
+static void font_file_close(font_file_T* file)
+{
+    file->refcount -= 1;
+
+    if (file->refcount > 0)
+        return;
+
+    for (size_t i = 0; i < files_size; i++)
+    {
+        if (files[i] == file)
+        {
+            files[i] = files[files_size - 1];
+            files_size -= 1;
+            break;
+        }
+    }
+
+    if (files_size == 0)
+    {
+        free(files);
+        files = (void*)0;
+    }
+
+    munmap((void*) file->data, file->size);
+    free(file->path);
+    free(file);
+}
+
+static font_face_T* font_face_open(const char* path, long face_index)
+{
+    for (size_t i = 0; i < faces_size; i++)
+    {
+        font_face_T* face = faces[i];
+
+        if (face->index == face_index && strcmp(face->file->path, path) == 0)
+        {
+            face->refcount += 1;
+            return face;
+        }
+    }
+
+    FT_Library ft = font_get_library();
+
+    if (ft == (void*)0)
+        return (void*)0;
+
+    font_file_T* file = font_file_open(path);
+
+    if (file == (void*)0)
+        return (void*)0;
+
+    // Load font as face, FreeType reads the tables straight from the mapping
+    FT_Face ft_face;
+    if (FT_New_Memory_Face(ft, file->data, file->size, face_index, &ft_face))
+    {
+        perror("ERROR::FREETYPE: Failed to load font");
+        font_file_close(file);
+        return (void*)0;
+    }
+
+    font_face_T* face = calloc(1, sizeof(struct FONT_FACE_STRUCT));
+    face->file = file;
+    face->index = face_index;
+    face->face = ft_face;
+    face->refcount = 1;
+    pthread_mutex_init(&face->lock, (void*)0);
+
+    faces_size += 1;
+    faces = realloc(faces, sizeof(struct FONT_FACE_STRUCT*) * faces_size);
+    faces[faces_size - 1] = face;
+
+    return face;
+}
+
+static void font_face_close(font_face_T* face)
+{
+    face->refcount -= 1;
+
+    if (face->refcount > 0)
+        return;
+
+    for (size_t i = 0; i < faces_size; i++)
+    {
+        if (faces[i] == face)
+        {
+            faces[i] = faces[faces_size - 1];
+            faces_size -= 1;
+            break;
+        }
+    }
+
+    raster_pool_forget_face(face);
+
+    // Also releases every FT_Size created on the face
+    FT_Done_Face(face->face);
+    pthread_mutex_destroy(&face->lock);
+    font_file_close(face->file);
+    free(face);
+
+    if (faces_size == 0)
+    {
+        free(faces);
+        faces = (void*)0;
+
+        // Destroy FreeType once we're finished
+        FT_Done_FreeType(library);
+        library = (void*)0;
+    }
+}
+
+/**
+ * Returns a font for (path, face_index, pixel_size, mode),
+ * reusing an already opened one when possible.
+ * Every call must be paired with a font_close.
+ */
+font_T* font_open(const char* path, long face_index, int pixel_size, int mode)
+{
+    for (size_t i = 0; i < fonts_size; i++)
+    {
+        font_T* font = fonts[i];
+
+        if (font->pixel_size == pixel_size
+            && font->mode == mode
+            && font->face->index == face_index
+            && strcmp(font->face->file->path, path) == 0)
+        {
+            return font_retain(font);
+        }
+    }
+
+    font_face_T* face = font_face_open(path, face_index);
+
+    if (face == (void*)0)
+        return (void*)0;
+
+    pthread_mutex_lock(&face->lock);
+
+    FT_Size size;
+    if (FT_New_Size(face->face, &size))
+    {
+        pthread_mutex_unlock(&face->lock);
+        perror("ERROR::FREETYPE: Failed to create size");
+        font_face_close(face);
+        return (void*)0;
+    }
+
+    // Set size to load glyphs as
+    FT_Activate_Size(size);
+    FT_Set_Pixel_Sizes(face->face, 0, pixel_size);
+
+    pthread_mutex_unlock(&face->lock);
+
+    font_T* font = calloc(1, sizeof(struct FONT_STRUCT));
+    font->face = face;
+    font->pixel_size = pixel_size;
+    font->mode = mode;
+    font->line_height = size->metrics.height >> 6;
+    font->size = size;
+    font->metrics = metrics_new_table();
+    font->glyphs = glyph_cache_new_table(font);
+    font->refcount = 1;
+
+    fonts_size += 1;
+    fonts = realloc(fonts, sizeof(struct FONT_STRUCT*) * fonts_size);
+    fonts[fonts_size - 1] = font;
+
+    return font;
+}
+
+/**
+ * Creates a font without a face for glyphs baked ahead of time,
+ * see baked.h. FreeType is never initialized for it.
+ */
+font_T* font_new_baked(int pixel_size, int line_height)
+{
+    font_T* font = calloc(1, sizeof(struct FONT_STRUCT));
+    font->pixel_size = pixel_size;
+    font->line_height = line_height;
+    font->metrics = metrics_new_table();
+    font->glyphs = glyph_cache_new_table(font);
+    font->refcount = 1;
+
+    return font;
+}
+
+font_T* font_retain(font_T* font)
+{
+    font->refcount += 1;
+    return font;
+}
+
+void font_close(font_T* font)
+{
+    font->refcount -= 1;
+
+    if (font->refcount > 0)
+        return;
+
+    for (size_t i = 0; i < fonts_size; i++)
+    {
+        if (fonts[i] == font)
+        {
+            fonts[i] = fonts[fonts_size - 1];
+            fonts_size -= 1;
+            break;
+        }
+    }
+
+    if (fonts_size == 0)
+    {
+        free(fonts);
+        fonts = (void*)0;
+    }
+
+    glyph_cache_free_table(font->glyphs);
+    metrics_free_table(font->metrics);
+
+    if (font->face != (void*)0)
+    {
+        pthread_mutex_lock(&font->face->lock);
+        FT_Done_Size(font->size);
+        pthread_mutex_unlock(&font->face->lock);
+
+        font_face_close(font->face);
+    }
+
+    free(font);
+}
+
+static uint32_t font_read_u32(const unsigned char* data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+/**
+ * Finds the head table of the sfnt font starting at `offset` and reads its checkSumAdjustment,
+ * which covers every byte of that font. Returns 0 when there is none.
+ */
+static int font_file_read_checksum(font_file_T* file, size_t offset, uint32_t* checksum)
+{
+    if (offset > file->size || file->size - offset < 12)
+        return 0;
+
+    size_t tables = ((size_t)file->data[offset + 4] << 8) | file->data[offset + 5];
+
+    for (size_t i = 0; i < tables; i++)
+    {
+        size_t record = offset + 12 + i * 16;
+
+        if (record + 16 > file->size)
+            return 0;
+
+        if (memcmp(&file->data[record], "head", 4) != 0)
+            continue;
+
+        size_t head = font_read_u32(&file->data[record + 8]);
+
+        if (head > file->size || file->size - head < 12)
+            return 0;
+
+        *checksum = font_read_u32(&file->data[head + 8]);
+        return 1;
+    }
+
+    return 0;
+}
+
+static uint64_t font_hash_mix(uint64_t hash, uint64_t value)
+{
+    hash ^= value * 0x87c37b91114253d5ULL;
+    return ((hash << 31) | (hash >> 33)) * 0x4cf5ad432745937fULL;
+}
+
+/**
+ * Identifies the contents of a font file across runs from its size and the
+ * checkSumAdjustment of every font inside of it, so only the table directories and head tables
+ * are read from disk. Files without them fall back to their modification time and inode.
+ */
+uint64_t font_get_file_hash(font_T* font)
+{
+    font_file_T* file = font->face->file;
+
+    if (file->hash != 0)
+        return file->hash;
+
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ file->size;
+    uint32_t checksum = 0;
+    int found = 0;
+
+    // Collections list the offsets of their fonts after the header
+    if (file->size >= 12 && memcmp(file->data, "ttcf", 4) == 0)
+    {
+        size_t count = font_read_u32(&file->data[8]);
+
+        for (size_t i = 0; i < count && 16 + i * 4 <= file->size; i++)
+        {
+            if (!font_file_read_checksum(file, font_read_u32(&file->data[12 + i * 4]), &checksum))
+                continue;
+
+            hash = font_hash_mix(hash, checksum);
+            found = 1;
+        }
+    }
+    else if (font_file_read_checksum(file, 0, &checksum))
+    {
+        hash = font_hash_mix(hash, checksum);
+        found = 1;
+    }
+
+    if (!found)
+    {
+        hash = font_hash_mix(hash, file->modified);
+        hash = font_hash_mix(hash, file->inode);
+    }
+
+    // murmur3 finalizer
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+
+    file->hash = hash ? hash : 1;
+
+    return file->hash;
+}
+
+/**
+ * Takes exclusive use of the face and makes the pixel size of this font
+ * the current one on it, must be called before loading glyphs from the returned face.
+ * Release with font_unlock.
+ */
+FT_Face font_lock(font_T* font)
+{
+    pthread_mutex_lock(&font->face->lock);
+    FT_Activate_Size(font->size);
+
+    return font->face->face;
+}
+
+void font_unlock(font_T* font)
+{
+    pthread_mutex_unlock(&font->face->lock);
+}
@@ -0,0 +1,641 @@
+#include "include/glyph_cache.h"
+#include "include/raster_pool.h"
+#include "include/atlas.h"
+#include "include/utf8.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+static size_t size = 0;
+static size_t pages = 0;
+static size_t pending = 0;    // Jobs submitted to the raster pool and not added yet
+
+static unsigned long hits = 0;
+static unsigned long misses = 0;
+static unsigned long generation = 0;
+static unsigned long evictions = 0;
+static uint32_t frame = 0;    // Counted up by glyph_cache_update, glyphs remember the last one they were used in
+
+static double frame_budget = GLYPH_CACHE_UNLIMITED;
+static double frame_spent = 0;
+static int deferred = 0;      // Misses were left for the next frame without the pool
+static double repack_budget = 0;
+
+static double glyph_cache_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+glyph_table_T* glyph_cache_new_table(font_T* font)
+{
+    glyph_table_T* table = calloc(1, sizeof(struct GLYPH_TABLE_STRUCT));
+
+    // All bits set is GLYPH_ID_NONE
+    memset(table->latin1, 0xFF, sizeof(table->latin1));
+
+    // Stands in for glyphs that are not rasterized yet, blank and half an em wide
+    table->placeholder = glyph_store_add();
+    glyph_store_get()->advance[table->placeholder] = font->pixel_size / 2;
+
+    return table;
+}
+
+/**
+ * Gives the atlas space and the ID of a glyph back.
+ */
+static void glyph_cache_release(glyph_id_T glyph)
+{
+    glyph_store_T* store = glyph_store_get();
+
+    atlas_region_T region;
+    region.page = store->page[glyph];
+    region.x = store->atlas_x[glyph];
+    region.y = store->atlas_y[glyph];
+    region.width = store->width[glyph];
+    region.height = store->height[glyph];
+
+    atlas_remove(&region);
+    glyph_store_remove(glyph);
+}
+
+static void glyph_cache_free_entries(glyph_id_T* entries, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (entries[i] == GLYPH_ID_NONE || entries[i] == GLYPH_ID_PENDING)
+            continue;
+
+        glyph_cache_release(entries[i]);
+        size -= 1;
+    }
+}
+
+/**
+ * Drops and frees every glyph of a table,
+ * called when its font is closed.
+ */
+void glyph_cache_free_table(glyph_table_T* table)
+{
+    glyph_store_remove(table->placeholder);
+    glyph_cache_free_entries(table->latin1, GLYPH_TABLE_LATIN1_SIZE);
+
+    for (size_t i = 0; i < table->pages_size; i++)
+    {
+        if (table->pages[i] == (void*)0)
+            continue;
+
+        glyph_cache_free_entries(table->pages[i], GLYPH_TABLE_PAGE_SIZE);
+        free(table->pages[i]);
+        pages -= 1;
+    }
+
+    free(table->pages);
+    free(table);
+}
+
+/**
+ * Returns the table entry of a codepoint above Latin-1,
+ * allocating its page on first use.
+ */
+static glyph_id_T* glyph_cache_entry(glyph_table_T* table, uint32_t codepoint)
+{
+    size_t page = codepoint >> GLYPH_TABLE_PAGE_SHIFT;
+
+    if (page >= table->pages_size)
+    {
+        size_t pages_size = table->pages_size ? table->pages_size : 16;
+
+        while (pages_size <= page)
+            pages_size *= 2;
+
+        if (pages_size > GLYPH_TABLE_PAGES)
+            pages_size = GLYPH_TABLE_PAGES;
+
+        table->pages = realloc(table->pages, sizeof(glyph_id_T*) * pages_size);
+        memset(&table->pages[table->pages_size], 0, sizeof(glyph_id_T*) * (pages_size - table->pages_size));
+        table->pages_size = pages_size;
+    }
+
+    if (table->pages[page] == (void*)0)
+    {
+        table->pages[page] = malloc(sizeof(glyph_id_T) * GLYPH_TABLE_PAGE_SIZE);
+        memset(table->pages[page], 0xFF, sizeof(glyph_id_T) * GLYPH_TABLE_PAGE_SIZE);
+        pages += 1;
+    }
+
+    return &table->pages[page][codepoint & (GLYPH_TABLE_PAGE_SIZE - 1)];
+}
+
+static glyph_id_T* glyph_cache_table_lookup(glyph_table_T* table, uint32_t codepoint)
+{
+    if (codepoint < GLYPH_TABLE_LATIN1_SIZE)
+        return &table->latin1[codepoint];
+
+    return glyph_cache_entry(table, codepoint);
+}
+
+static glyph_id_T* glyph_cache_lookup(font_T* font, uint32_t codepoint)
+{
+    return glyph_cache_table_lookup(font->glyphs, codepoint);
+}
+
+/**
+ * Records where a new glyph is cached so it can be evicted later on.
+ */
+static void glyph_cache_track(glyph_table_T* table, uint32_t codepoint, glyph_id_T glyph)
+{
+    glyph_store_T* store = glyph_store_get();
+    store->codepoint[glyph] = codepoint;
+    store->table[glyph] = table;
+    store->last_used[glyph] = frame;
+}
+
+/**
+ * Drops the count of jobs a stopped raster pool released without returning.
+ * Their entries stay pending and are reset when they are next looked up.
+ */
+static void glyph_cache_forget_pending()
+{
+    if (!raster_pool_running())
+        pending = 0;
+}
+
+/**
+ * Rasterizes a missing glyph on this thread and fills its entry.
+ */
+static glyph_id_T glyph_cache_rasterize(font_T* font, uint32_t codepoint, glyph_id_T* entry)
+{
+    misses += 1;
+
+    double start = glyph_cache_now();
+
+    *entry = get_character(font, codepoint);
+    glyph_cache_track(font->glyphs, codepoint, *entry);
+    size += 1;
+
+    frame_spent += glyph_cache_now() - start;
+
+    return *entry;
+}
+
+/**
+ * Returns the cached glyph for this font and codepoint,
+ * rasterizing and uploading it only the first time it is requested.
+ * The returned glyph is shared and owned by the cache.
+ */
+glyph_id_T glyph_cache_get(font_T* font, uint32_t codepoint)
+{
+    if (codepoint > 0x10FFFF)
+        codepoint = UTF8_REPLACEMENT;
+
+    glyph_id_T* entry = glyph_cache_lookup(font, codepoint);
+
+    if (*entry == GLYPH_ID_PENDING)
+    {
+        if (raster_pool_running())
+            return font->glyphs->placeholder;
+
+        // The pool was stopped before the job came back
+        glyph_cache_forget_pending();
+        *entry = GLYPH_ID_NONE;
+    }
+
+    if (*entry != GLYPH_ID_NONE)
+    {
+        hits += 1;
+        glyph_store_get()->last_used[*entry] = frame;
+        return *entry;
+    }
+
+    // Baked fonts cannot rasterize what they were not baked with
+    if (font->face == (void*)0)
+        return font->glyphs->placeholder;
+
+    int over_budget = frame_budget != GLYPH_CACHE_UNLIMITED && frame_spent >= frame_budget;
+
+    // Without the pool one glyph per frame is still rasterized so text always completes
+    if (over_budget && !raster_pool_running() && frame_spent > 0)
+    {
+        deferred = 1;
+        return font->glyphs->placeholder;
+    }
+
+    if (over_budget && raster_pool_running())
+    {
+        misses += 1;
+        *entry = GLYPH_ID_PENDING;
+        raster_pool_submit(font, codepoint);
+        pending += 1;
+
+        return font->glyphs->placeholder;
+    }
+
+    return glyph_cache_rasterize(font, codepoint, entry);
+}
+
+/**
+ * Adds the glyphs the raster pool finished, blocking for at least one when `wait` is set.
+ */
+static void glyph_cache_collect(int wait)
+{
+    raster_job_T* job = raster_pool_collect(wait);
+
+    if (job != (void*)0)
+        generation += 1;
+
+    // Everything that finished meanwhile is uploaded in one go
+    while (job != (void*)0)
+    {
+        raster_job_T* next = job->next;
+        glyph_id_T* entry = glyph_cache_lookup(job->font, job->codepoint);
+
+        // The glyph may have been inserted from elsewhere meanwhile
+        if (*entry == GLYPH_ID_PENDING)
+        {
+            *entry = add_character(&job->bitmap);
+            glyph_cache_track(job->font->glyphs, job->codepoint, *entry);
+            size += 1;
+        }
+
+        pending -= 1;
+
+        raster_pool_release(job);
+        job = next;
+    }
+}
+
+/**
+ * Adds a glyph that was created elsewhere, such as loaded from disk.
+ * A glyph already cached for the codepoint is kept and the new one removed.
+ */
+void glyph_cache_insert(font_T* font, uint32_t codepoint, glyph_id_T glyph)
+{
+    glyph_id_T* entry = glyph_cache_lookup(font, codepoint);
+
+    if (*entry != GLYPH_ID_NONE && *entry != GLYPH_ID_PENDING)
+    {
+        glyph_cache_release(glyph);
+        return;
+    }
+
+    // A pending job for it will find the entry filled and drop its result
+    *entry = glyph;
+    glyph_cache_track(font->glyphs, codepoint, glyph);
+    size += 1;
+}
+
+static size_t glyph_cache_list_entries(uint32_t base, glyph_id_T* entries, size_t count, uint32_t* codepoints, glyph_id_T* glyphs, size_t max, size_t size)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (entries[i] == GLYPH_ID_NONE || entries[i] == GLYPH_ID_PENDING)
+            continue;
+
+        if (size < max)
+        {
+            codepoints[size] = base + i;
+            glyphs[size] = entries[i];
+        }
+
+        size += 1;
+    }
+
+    return size;
+}
+
+/**
+ * Writes up to `max` cached codepoints of a font and their glyphs in codepoint order.
+ * Returns the amount of cached glyphs, which may be more than `max`.
+ */
+size_t glyph_cache_list(font_T* font, uint32_t* codepoints, glyph_id_T* glyphs, size_t max)
+{
+    glyph_table_T* table = font->glyphs;
+    size_t count = glyph_cache_list_entries(0, table->latin1, GLYPH_TABLE_LATIN1_SIZE, codepoints, glyphs, max, 0);
+
+    for (size_t i = 0; i < table->pages_size; i++)
+    {
+        if (table->pages[i] == (void*)0)
+            continue;
+
+        count = glyph_cache_list_entries(
+            i << GLYPH_TABLE_PAGE_SHIFT,
+            table->pages[i],
+            GLYPH_TABLE_PAGE_SIZE,
+            codepoints,
+            glyphs,
+            max,
+            count
+        );
+    }
+
+    return count;
+}
+
+/**
+ * Rasterizes every missing glyph of a set on the raster pool
+ * and adds them as they come back, blocking until all of them are cached.
+ * Falls back to rasterizing on this thread when the pool is not running.
+ */
+void glyph_cache_warm(font_T* font, const uint32_t* codepoints, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t codepoint = codepoints[i] > 0x10FFFF ? UTF8_REPLACEMENT : codepoints[i];
+        glyph_id_T* entry = glyph_cache_lookup(font, codepoint);
+
+        if (*entry != GLYPH_ID_NONE || font->face == (void*)0)
+            continue;
+
+        if (!raster_pool_running())
+        {
+            glyph_cache_rasterize(font, codepoint, entry);
+            continue;
+        }
+
+        misses += 1;
+        *entry = GLYPH_ID_PENDING;
+        raster_pool_submit(font, codepoint);
+        pending += 1;
+    }
+
+    // Glyphs streamed in by earlier frames are waited for as well
+    while (pending > 0 && raster_pool_running())
+        glyph_cache_collect(1);
+
+    glyph_cache_forget_pending();
+
+    // A stopped pool dropped its jobs, what is left of the set is rasterized here
+    for (size_t i = 0; i < count && !raster_pool_running(); i++)
+    {
+        uint32_t codepoint = codepoints[i] > 0x10FFFF ? UTF8_REPLACEMENT : codepoints[i];
+        glyph_id_T* entry = glyph_cache_lookup(font, codepoint);
+
+        if (*entry == GLYPH_ID_PENDING && font->face != (void*)0)
+            glyph_cache_rasterize(font, codepoint, entry);
+    }
+}
+
+static int glyph_cache_evictable(glyph_store_T* store, glyph_id_T glyph, int format)
+{
+    if (store->table[glyph] == (void*)0 || store->width[glyph] == 0)
+        return 0;
+
+    atlas_page_T* page = atlas_get_page(store->page[glyph]);
+
+    return !page->fixed && page->format == format;
+}
+
+static unsigned int glyph_cache_plot(glyph_store_T* store, glyph_id_T glyph)
+{
+    atlas_region_T region;
+    region.page = store->page[glyph];
+    region.x = store->atlas_x[glyph];
+    region.y = store->atlas_y[glyph];
+
+    return atlas_get_plot(&region);
+}
+
+/**
+ * Called by the atlas when a new glyph does not fit under its budget.
+ * Evicts every glyph of the atlas plot of that format whose most recent use is the oldest,
+ * which leaves the whole plot empty for new glyphs.
+ * Plots holding pinned glyphs or glyphs used this frame or the one before,
+ * which may still be drawn, are kept.
+ * Returns the amount of evicted glyphs, 0 when no plot can go.
+ */
+static int glyph_cache_evict(int format)
+{
+    glyph_store_T* store = glyph_store_get();
+    size_t plots = atlas_get_page_count() * ATLAS_PAGE_PLOTS;
+
+    // Frame each plot was last used in plus one, 0 for plots without glyphs
+    uint32_t* last_used = calloc(plots, sizeof(uint32_t));
+    uint8_t* kept = calloc(plots, sizeof(uint8_t));
+
+    for (glyph_id_T id = 0; id < store->size; id++)
+    {
+        if (!glyph_cache_evictable(store, id, format))
+            continue;
+
+        unsigned int plot = glyph_cache_plot(store, id);
+
+        if (store->last_used[id] + 1 > last_used[plot])
+            last_used[plot] = store->last_used[id] + 1;
+
+        if (store->pinned[id] || store->last_used[id] + 1 >= frame)
+            kept[plot] = 1;
+    }
+
+    size_t oldest = plots;
+
+    for (size_t i = 0; i < plots; i++)
+    {
+        if (last_used[i] == 0 || kept[i])
+            continue;
+
+        if (oldest == plots || last_used[i] < last_used[oldest])
+            oldest = i;
+    }
+
+    free(last_used);
+    free(kept);
+
+    if (oldest == plots)
+        return 0;
+
+    int count = 0;
+
+    for (glyph_id_T id = 0; id < store->size; id++)
+    {
+        if (!glyph_cache_evictable(store, id, format) || glyph_cache_plot(store, id) != oldest)
+            continue;
+
+        *glyph_cache_table_lookup(store->table[id], store->codepoint[id]) = GLYPH_ID_NONE;
+        glyph_cache_release(id);
+        size -= 1;
+        evictions += 1;
+        count += 1;
+    }
+
+    return count;
+}
+
+/**
+ * Limits the texture memory of the glyph atlas to `bytes`, ATLAS_BUDGET_UNLIMITED for no limit.
+ * Once the pages reach it, the least recently used glyphs make room for new ones.
+ */
+void glyph_cache_set_atlas_budget(size_t bytes)
+{
+    atlas_set_budget(bytes, glyph_cache_evict);
+}
+
+/**
+ * Caches a set of glyphs like glyph_cache_warm and keeps them from being evicted.
+ */
+void glyph_cache_pin(font_T* font, const uint32_t* codepoints, size_t count)
+{
+    glyph_cache_warm(font, codepoints, count);
+
+    glyph_store_T* store = glyph_store_get();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t codepoint = codepoints[i] > 0x10FFFF ? UTF8_REPLACEMENT : codepoints[i];
+        glyph_id_T glyph = *glyph_cache_lookup(font, codepoint);
+
+        if (glyph != GLYPH_ID_NONE && glyph != GLYPH_ID_PENDING)
+            store->pinned[glyph] = 1;
+    }
+}
+
+/**
+ * Lets pinned glyphs be evicted again, codepoints that are not cached are ignored.
+ */
+void glyph_cache_unpin(font_T* font, const uint32_t* codepoints, size_t count)
+{
+    glyph_store_T* store = glyph_store_get();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t codepoint = codepoints[i] > 0x10FFFF ? UTF8_REPLACEMENT : codepoints[i];
+        glyph_id_T glyph = *glyph_cache_lookup(font, codepoint);
+
+        if (glyph != GLYPH_ID_NONE && glyph != GLYPH_ID_PENDING)
+            store->pinned[glyph] = 0;
+    }
+}
+
+/**
+ * Marks glyphs as used this frame without looking them up,
+ * for text that is drawn from a layout made on an earlier frame.
+ */
+void glyph_cache_touch(const glyph_id_T* glyphs, size_t count)
+{
+    glyph_store_T* store = glyph_store_get();
+
+    for (size_t i = 0; i < count; i++)
+        store->last_used[glyphs[i]] = frame;
+}
+
+/**
+ * Sets how many milliseconds per frame may be spent rasterizing on the calling thread.
+ * Misses past the budget return the font's placeholder and are rasterized
+ * on the raster pool, or on a later frame when the pool is not running.
+ * GLYPH_CACHE_UNLIMITED always rasterizes right away.
+ */
+void glyph_cache_set_frame_budget(double milliseconds)
+{
+    frame_budget = milliseconds;
+}
+
+/**
+ * Sets how many milliseconds per frame may be spent moving glyphs off sparse atlas pages,
+ * see atlas_begin_repack. 0 never repacks.
+ */
+void glyph_cache_set_repack_budget(double milliseconds)
+{
+    repack_budget = milliseconds;
+}
+
+/**
+ * Moves glyphs off the atlas pages being repacked until the frame's repack budget is spent.
+ * Store entries are only changed once the texels are in place, so every lookup
+ * finds a glyph either entirely at its old place or entirely at its new one.
+ */
+static void glyph_cache_repack()
+{
+    if (repack_budget <= 0 || atlas_begin_repack() < 0)
+        return;
+
+    glyph_store_T* store = glyph_store_get();
+    double start = glyph_cache_now();
+
+    for (glyph_id_T id = 0; id < store->size; id++)
+    {
+        if (store->table[id] == (void*)0 || store->width[id] == 0)
+            continue;
+
+        if (!atlas_get_page(store->page[id])->repacking)
+            continue;
+
+        atlas_region_T from;
+        from.page = store->page[id];
+        from.x = store->atlas_x[id];
+        from.y = store->atlas_y[id];
+        from.width = store->width[id];
+        from.height = store->height[id];
+
+        atlas_region_T to;
+        if (!atlas_move(&from, &to))
+            return;
+
+        store->page[id] = to.page;
+        store->atlas_x[id] = to.x;
+        store->atlas_y[id] = to.y;
+
+        if (glyph_cache_now() - start >= repack_budget)
+            return;
+    }
+
+    // Whatever is left on the drained pages is not cached by any table and cannot be moved
+    atlas_cancel_repack();
+}
+
+/**
+ * Starts a new frame: resets the budget and adds the glyphs that finished meanwhile.
+ * Call once per frame on the GL thread before laying out text.
+ */
+void glyph_cache_update()
+{
+    frame_spent = 0;
+    frame += 1;
+
+    glyph_cache_forget_pending();
+
+    if (pending > 0)
+        glyph_cache_collect(0);
+
+    // Text waiting on deferred misses gets another try this frame
+    if (deferred)
+    {
+        generation += 1;
+        deferred = 0;
+    }
+
+    glyph_cache_repack();
+}
+
+/**
+ * Changes whenever streamed or deferred glyphs may have become available,
+ * text laid out with placeholders should be laid out again.
+ */
+unsigned long glyph_cache_get_generation()
+{
+    return generation;
+}
+
+glyph_cache_stats_T glyph_cache_get_stats()
+{
+    glyph_cache_forget_pending();
+
+    glyph_cache_stats_T stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.size = size;
+    stats.pages = pages;
+    stats.pending = pending;
+    stats.evictions = evictions;
+
+    return stats;
+}
+
+void glyph_cache_reset_stats()
+{
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+}
@@ -0,0 +1,110 @@
+#include "include/glyph_instance.h"
+#include "include/atlas.h"
+#include <stddef.h>
+
+
+glyph_instance_layout_T glyph_instance_get_layout(GLuint program)
+{
+    glyph_instance_layout_T layout;
+    layout.rect_location = glGetAttribLocation(program, "rect");
+    layout.uv_location = glGetAttribLocation(program, "uv_rect");
+    layout.color_location = glGetAttribLocation(program, "color");
+    layout.phase_location = glGetAttribLocation(program, "phase");
+    layout.format_location = glGetUniformLocation(program, "format");
+
+    return layout;
+}
+
+/**
+ * Enables the instance attributes on a VAO and makes them advance once per instance.
+ */
+void glyph_instance_setup_vao(glyph_instance_layout_T* layout, GLuint VAO)
+{
+    GLint locations[] = {
+        layout->rect_location,
+        layout->uv_location,
+        layout->color_location,
+        layout->phase_location
+    };
+
+    glBindVertexArray(VAO);
+
+    for (size_t i = 0; i < sizeof(locations) / sizeof(GLint); i++)
+    {
+        glEnableVertexAttribArray(locations[i]);
+        glVertexAttribDivisor(locations[i], 1);
+    }
+
+    glBindVertexArray(0);
+}
+
+/**
+ * Draws `count` instances of one atlas page stored at `offset` bytes into VBO.
+ * Expects a VAO set up with glyph_instance_setup_vao to be bound
+ * and the program the layout was taken from to be in use.
+ * OpenGL 3.3 has no base instance, so the attributes are pointed at the offset instead.
+ */
+void glyph_instance_draw(glyph_instance_layout_T* layout, GLuint VBO, size_t offset, unsigned int page, size_t count)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    glVertexAttribPointer(
+        layout->rect_location, 4, GL_FLOAT, GL_FALSE, GLYPH_INSTANCE_STRIDE,
+        (void*)(offset + offsetof(struct GLYPH_INSTANCE_STRUCT, x))
+    );
+    glVertexAttribPointer(
+        layout->uv_location, 4, GL_FLOAT, GL_FALSE, GLYPH_INSTANCE_STRIDE,
+        (void*)(offset + offsetof(struct GLYPH_INSTANCE_STRUCT, u0))
+    );
+    glVertexAttribPointer(
+        layout->color_location, 4, GL_UNSIGNED_BYTE, GL_TRUE, GLYPH_INSTANCE_STRIDE,
+        (void*)(offset + offsetof(struct GLYPH_INSTANCE_STRUCT, color))
+    );
+    glVertexAttribPointer(
+        layout->phase_location, 1, GL_FLOAT, GL_FALSE, GLYPH_INSTANCE_STRIDE,
+        (void*)(offset + offsetof(struct GLYPH_INSTANCE_STRUCT, phase))
+    );
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    atlas_page_T* atlas_page = atlas_get_page(page);
+
+    // Tells the fragment shader how to turn texels into coverage
+    if (layout->format_location >= 0)
+        glUniform1i(layout->format_location, atlas_page->format);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlas_get_texture(atlas_page));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, GLYPH_INSTANCE_QUAD_VERTICES, count);
+}
+
+/**
+ * Fills in the instance of a glyph with its pen position at (x, y) on the baseline.
+ * Returns 0 for blank glyphs, which only advance the pen and need no instance.
+ */
+int glyph_instance_init(glyph_instance_T* instance, glyph_id_T glyph, float x, float y, float scale, uint32_t color, float phase)
+{
+    glyph_store_T* store = glyph_store_get();
+    float width = store->width[glyph];
+    float height = store->height[glyph];
+
+    if (width == 0 || height == 0)
+        return 0;
+
+    atlas_page_T* page = atlas_get_page(store->page[glyph]);
+    float atlas_x = store->atlas_x[glyph];
+    float atlas_y = store->atlas_y[glyph];
+
+    instance->x = x + store->bearing_left[glyph] * scale;
+    instance->y = y - (height - store->bearing_top[glyph]) * scale;
+    instance->width = width * scale;
+    instance->height = height * scale;
+    instance->u0 = atlas_x / page->width;
+    instance->v0 = atlas_y / page->height;
+    instance->u1 = (atlas_x + width) / page->width;
+    instance->v1 = (atlas_y + height) / page->height;
+    instance->color = color;
+    instance->phase = phase;
+
+    return 1;
+}
@@ -0,0 +1,100 @@
+#include "include/glyph_store.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+#define GLYPH_STORE_INITIAL_CAPACITY 256
+
+static glyph_store_T store;
+
+glyph_store_T* glyph_store_get()
+{
+    return &store;
+}
+
+static void glyph_store_grow()
+{
+    size_t capacity = store.capacity ? store.capacity * 2 : GLYPH_STORE_INITIAL_CAPACITY;
+
+    store.advance = realloc(store.advance, sizeof(int16_t) * capacity);
+    store.bearing_left = realloc(store.bearing_left, sizeof(int16_t) * capacity);
+    store.bearing_top = realloc(store.bearing_top, sizeof(int16_t) * capacity);
+    store.width = realloc(store.width, sizeof(uint16_t) * capacity);
+    store.height = realloc(store.height, sizeof(uint16_t) * capacity);
+    store.atlas_x = realloc(store.atlas_x, sizeof(uint16_t) * capacity);
+    store.atlas_y = realloc(store.atlas_y, sizeof(uint16_t) * capacity);
+    store.page = realloc(store.page, sizeof(uint16_t) * capacity);
+    store.codepoint = realloc(store.codepoint, sizeof(uint32_t) * capacity);
+    store.table = realloc(store.table, sizeof(struct GLYPH_TABLE_STRUCT*) * capacity);
+    store.last_used = realloc(store.last_used, sizeof(uint32_t) * capacity);
+    store.pinned = realloc(store.pinned, sizeof(uint8_t) * capacity);
+    store.capacity = capacity;
+}
+
+/**
+ * Hands out an ID with all of its fields zeroed.
+ * The arrays may move, pointers into them must not be kept across calls.
+ */
+glyph_id_T glyph_store_add()
+{
+    glyph_id_T id;
+
+    if (store.free_ids_size > 0)
+    {
+        id = store.free_ids[--store.free_ids_size];
+    }
+    else
+    {
+        if (store.size == store.capacity)
+            glyph_store_grow();
+
+        id = store.size++;
+    }
+
+    store.advance[id] = 0;
+    store.bearing_left[id] = 0;
+    store.bearing_top[id] = 0;
+    store.width[id] = 0;
+    store.height[id] = 0;
+    store.atlas_x[id] = 0;
+    store.atlas_y[id] = 0;
+    store.page[id] = 0;
+    store.codepoint[id] = 0;
+    store.table[id] = (void*)0;
+    store.last_used[id] = 0;
+    store.pinned[id] = 0;
+
+    return id;
+}
+
+void glyph_store_remove(glyph_id_T id)
+{
+    if (store.free_ids_size == store.free_ids_capacity)
+    {
+        store.free_ids_capacity = store.free_ids_capacity ? store.free_ids_capacity * 2 : 64;
+        store.free_ids = realloc(store.free_ids, sizeof(glyph_id_T) * store.free_ids_capacity);
+    }
+
+    store.free_ids[store.free_ids_size++] = id;
+
+    // Freed IDs are skipped by eviction
+    store.table[id] = (void*)0;
+}
+
+void glyph_store_free()
+{
+    free(store.advance);
+    free(store.bearing_left);
+    free(store.bearing_top);
+    free(store.width);
+    free(store.height);
+    free(store.atlas_x);
+    free(store.atlas_y);
+    free(store.page);
+    free(store.codepoint);
+    free(store.table);
+    free(store.last_used);
+    free(store.pinned);
+    free(store.free_ids);
+    memset(&store, 0, sizeof(struct GLYPH_STORE_STRUCT));
+}
@@ -0,0 +1,123 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+#include <GL/glew.h>
+#include <stddef.h>
+#include "upload_thread.h"
+
+
+#define ATLAS_PAGE_SIZE 1024
+#define ATLAS_PLOT_SIZE 512   // Pages are split into square plots, each packed and emptied on its own
+#define ATLAS_PAGE_PLOTS ((ATLAS_PAGE_SIZE / ATLAS_PLOT_SIZE) * (ATLAS_PAGE_SIZE / ATLAS_PLOT_SIZE))
+#define ATLAS_PADDING 1   // Empty texels kept around every glyph to avoid bleeding
+
+#define ATLAS_FORMAT_COVERAGE 0   // Sampled as is with GL_NEAREST
+#define ATLAS_FORMAT_SDF 1        // Signed distance fields sampled with GL_LINEAR, see sdf.h
+#define ATLAS_FORMAT_MSDF 2       // Multi-channel distance fields in GL_RGB8 texels, see msdf.h
+
+#define ATLAS_BUDGET_UNLIMITED 0  // Pages are added whenever the existing ones are full
+#define ATLAS_REPACK_FILL 0.8     // Share of a page the glyphs of repacked pages may fill at most
+
+#define ATLAS_STAGING_SIZE (256 * 1024)   // Bytes of the pixel buffer ring uploads are staged in per frame, grows when exceeded
+#define ATLAS_COALESCE_WASTE 1.5  // Pending rects are merged while their bounding box is at most this much larger than both
+
+typedef struct ATLAS_SKYLINE_NODE_STRUCT
+{
+    int x;
+    int y;
+    int width;
+} atlas_skyline_node_T;
+
+typedef struct ATLAS_RECT_STRUCT
+{
+    int x;
+    int y;
+    int width;
+    int height;
+} atlas_rect_T;
+
+/**
+ * One of the two textures of a page and the changes to the CPU copy it has yet to receive.
+ */
+typedef struct ATLAS_BUFFER_STRUCT
+{
+    GLuint texture;   // GL_R8 or GL_RGB8
+    GLsync fence;     // Signaled once the draws that sampled the texture are done, 0 when there are none
+    upload_job_T* upload;     // Pending rects being written by the upload thread, the texture becomes the front one after
+    atlas_rect_T* pending;
+    size_t pending_size;
+    size_t pending_capacity;
+} atlas_buffer_T;
+
+/**
+ * A square of a page with its own skyline, the unit the space of removed glyphs is reused in.
+ */
+typedef struct ATLAS_PLOT_STRUCT
+{
+    atlas_skyline_node_T* nodes;    // Relative to the corner of the plot
+    size_t nodes_size;
+    unsigned int glyphs;      // Glyphs added and not removed yet, the plot starts over once none are left
+} atlas_plot_T;
+
+typedef struct ATLAS_PAGE_STRUCT
+{
+    atlas_buffer_T buffers[2];    // Draws sample the front one while the other is written, see atlas_publish
+    int front;
+    int format;       // ATLAS_FORMAT_* of every glyph on this page
+    unsigned char* pixels;    // CPU copy of the texture, atlas_get_channels bytes per texel, null once released
+    int width;
+    int height;
+    atlas_plot_T* plots;      // ATLAS_PAGE_PLOTS row by row, none on fixed pages
+    unsigned int glyphs;      // Glyphs added and not removed yet
+    size_t area;              // Texels taken by those glyphs and their padding
+    unsigned long relocated;  // atlas_get_relocations() when a glyph last moved off the page or it was released
+    int repacking;            // Glyphs are being moved off the page, nothing new is placed on it
+    int fixed;                // Packed ahead of time, glyphs are never added or removed
+} atlas_page_T;
+
+typedef struct ATLAS_REGION_STRUCT
+{
+    unsigned int page;
+    int x;
+    int y;
+    int width;
+    int height;
+} atlas_region_T;
+
+void atlas_set_headless(int enabled);
+
+int atlas_get_channels(int format);
+
+int atlas_add(int format, int width, int height, int pitch, const unsigned char* pixels, atlas_region_T* region);
+
+void atlas_remove(const atlas_region_T* region);
+
+int atlas_begin_repack();
+
+void atlas_cancel_repack();
+
+int atlas_move(const atlas_region_T* from, atlas_region_T* to);
+
+unsigned long atlas_get_relocations();
+
+unsigned int atlas_get_plot(const atlas_region_T* region);
+
+int atlas_get_used_height(atlas_page_T* page);
+
+void atlas_set_budget(size_t limit, int (*evict_callback)(int format));
+
+size_t atlas_get_bytes();
+
+unsigned int atlas_add_page(int width, int height, const unsigned char* pixels);
+
+void atlas_publish();
+
+void atlas_end_frame();
+
+GLuint atlas_get_texture(atlas_page_T* page);
+
+atlas_page_T* atlas_get_page(unsigned int index);
+
+size_t atlas_get_page_count();
+
+void atlas_free();
+#endif
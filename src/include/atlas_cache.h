@@ -0,0 +1,48 @@
+#ifndef ATLAS_CACHE_H
+#define ATLAS_CACHE_H
+#include <stdint.h>
+#include <stddef.h>
+#include "font.h"
+
+
+#define ATLAS_CACHE_MAGIC "FGLC"
+#define ATLAS_CACHE_VERSION 3
+#define ATLAS_CACHE_BYTE_ORDER 0x01020304   // Reads as 0x04030201 on machines of the other byte order
+
+/**
+ * Start of a cache file, every field must match the font for the file to be used.
+ */
+typedef struct ATLAS_CACHE_HEADER_STRUCT
+{
+    char magic[4];            // ATLAS_CACHE_MAGIC
+    uint32_t version;         // ATLAS_CACHE_VERSION
+    uint64_t font_hash;       // See font_get_file_hash
+    int32_t face_index;
+    int32_t pixel_size;
+    int32_t mode;             // FONT_MODE_* the bitmaps were rendered in
+    uint32_t load_flags;      // See character_get_load_flags
+    uint32_t glyphs_size;
+    uint32_t byte_order;      // ATLAS_CACHE_BYTE_ORDER, rejects files written with the other byte order
+} atlas_cache_header_T;
+
+/**
+ * One glyph, the header is followed by glyphs_size of these and then the bitmaps.
+ */
+typedef struct ATLAS_CACHE_GLYPH_STRUCT
+{
+    uint32_t codepoint;
+    uint32_t offset;          // Of the tightly packed bitmap from the start of the file, in the font's atlas format
+    int16_t advance;
+    int16_t bearing_left;
+    int16_t bearing_top;
+    uint16_t width;
+    uint16_t height;
+    uint16_t reserved;
+} atlas_cache_glyph_T;
+
+const char* atlas_cache_get_directory();
+
+size_t atlas_cache_load(font_T* font, const char* directory);
+
+int atlas_cache_save(font_T* font, const char* directory);
+#endif
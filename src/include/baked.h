@@ -0,0 +1,69 @@
+#ifndef BAKED_H
+#define BAKED_H
+#include <stdint.h>
+#include <stddef.h>
+#include "font.h"
+
+
+#define BAKED_MAGIC "FGLB"
+#define BAKED_VERSION 1
+#define BAKED_NAME_SIZE 64
+
+/**
+ * Start of a file written by fontbake. It is followed by fonts_size fonts,
+ * glyphs_size glyphs and pages_size pages of page_width * page_height bytes.
+ */
+typedef struct BAKED_HEADER_STRUCT
+{
+    char magic[4];            // BAKED_MAGIC
+    uint32_t version;         // BAKED_VERSION
+    uint32_t page_width;
+    uint32_t page_height;
+    uint32_t pages_size;
+    uint32_t fonts_size;
+    uint32_t glyphs_size;
+    uint32_t reserved;
+} baked_header_T;
+
+typedef struct BAKED_FONT_STRUCT
+{
+    char name[BAKED_NAME_SIZE];   // File name of the font without directories
+    int32_t face_index;
+    int32_t pixel_size;
+    int32_t line_height;
+    uint32_t glyphs_start;    // First glyph of the font in the glyph table
+    uint32_t glyphs_size;
+    uint32_t reserved;
+} baked_font_T;
+
+typedef struct BAKED_GLYPH_STRUCT
+{
+    uint32_t codepoint;
+    int16_t advance;
+    int16_t bearing_left;
+    int16_t bearing_top;
+    uint16_t width;
+    uint16_t height;
+    uint16_t atlas_x;
+    uint16_t atlas_y;
+    uint16_t page;            // Index into the pages of the file
+} baked_glyph_T;
+
+/**
+ * Baked data uploaded to the atlas, one font per baked font and size.
+ */
+typedef struct BAKED_ATLAS_STRUCT
+{
+    baked_font_T* infos;
+    font_T** fonts;
+    size_t fonts_size;
+} baked_atlas_T;
+
+baked_atlas_T* baked_load(const unsigned char* data, size_t size);
+
+baked_atlas_T* baked_load_file(const char* path);
+
+font_T* baked_find_font(baked_atlas_T* atlas, const char* name, int pixel_size);
+
+void baked_free(baked_atlas_T* atlas);
+#endif
@@ -0,0 +1,53 @@
+#ifndef CHARACTER_H
+#define CHARACTER_H
+#include <stddef.h>
+#include "font.h"
+#include "glyph_store.h"
+
+
+#define CHARACTER_LOAD_FLAGS FT_LOAD_RENDER   // How every glyph is rendered into the atlas
+#define CHARACTER_OUTLINE_LOAD_FLAGS (FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING)   // Outlines for FONT_MODE_MSDF
+
+/**
+ * A rendered glyph in CPU memory, ready to be packed into the atlas.
+ */
+typedef struct GLYPH_BITMAP_STRUCT
+{
+    const unsigned char* pixels;    // rows * pitch bytes
+    int width;
+    int rows;
+    int pitch;
+    int format;       // ATLAS_FORMAT_* of the pixels
+    int bearing_left;
+    int bearing_top;
+    int advance;      // Whole pixels
+} glyph_bitmap_T;
+
+/**
+ * A run of glyph IDs, reusable: clearing keeps the memory for the next fill.
+ */
+typedef struct GLYPH_RUN_STRUCT
+{
+    size_t size;
+    size_t capacity;
+    glyph_id_T* ids;
+} glyph_run_T;
+
+int character_get_format(font_T* font);
+
+int character_get_load_flags(font_T* font);
+
+unsigned char* character_convert(font_T* font, FT_GlyphSlot slot, glyph_bitmap_T* bitmap);
+
+glyph_id_T add_character(glyph_bitmap_T* bitmap);
+
+glyph_id_T get_character(font_T* font, uint32_t codepoint);
+
+glyph_run_T get_characters(const char* text, font_T* font);
+
+void glyph_run_fill(glyph_run_T* run, const char* text, font_T* font);
+
+void glyph_run_clear(glyph_run_T* run);
+
+void glyph_run_free(glyph_run_T* run);
+#endif
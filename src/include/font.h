@@ -0,0 +1,74 @@
+#ifndef FONT_H
+#define FONT_H
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_SIZES_H
+#include <pthread.h>
+#include <stdint.h>
+
+
+#define FONT_MODE_BITMAP 0    // Coverage bitmaps at the pixel size, sharp at a scale of 1
+#define FONT_MODE_SDF 1       // Signed distance fields that stay sharp at any scale
+#define FONT_MODE_MSDF 2      // Multi-channel distance fields that also keep corners sharp
+
+/**
+ * A font file mapped into memory, shared by every face inside of it.
+ * Pages are only read from disk once FreeType touches them.
+ */
+typedef struct FONT_FILE_STRUCT
+{
+    char* path;
+    const unsigned char* data;
+    size_t size;
+    int64_t modified;     // Identify files without sfnt checksums, see font_get_file_hash
+    uint64_t inode;
+    uint64_t hash;    // 0 until font_get_file_hash computed it
+    unsigned int refcount;
+} font_file_T;
+
+/**
+ * A face of a font file opened by FreeType, shared by every pixel size
+ * that is requested from it.
+ */
+typedef struct FONT_FACE_STRUCT
+{
+    font_file_T* file;
+    long index;       // Face index inside of the font file
+    FT_Face face;
+    pthread_mutex_t lock;   // FreeType faces must not be used by two threads at once
+    unsigned int refcount;
+} font_face_T;
+
+/**
+ * A face at a specific pixel size.
+ * Obtained with font_open and released with font_close.
+ * Baked fonts have no face and size, only the glyphs they were baked with.
+ */
+typedef struct FONT_STRUCT
+{
+    font_face_T* face;
+    int pixel_size;
+    int mode;         // FONT_MODE_* the glyphs are rendered with
+    int line_height;  // Baseline to baseline distance in pixels
+    FT_Size size;     // Size object owned by the face, activated before loading glyphs
+    struct METRICS_TABLE_STRUCT* metrics;   // Glyph metrics measured so far, see metrics.h
+    struct GLYPH_TABLE_STRUCT* glyphs;      // Cached glyph IDs by codepoint, see glyph_cache.h
+    unsigned int refcount;
+} font_T;
+
+FT_Library font_get_library();
+
+font_T* font_open(const char* path, long face_index, int pixel_size, int mode);
+
+font_T* font_new_baked(int pixel_size, int line_height);
+
+font_T* font_retain(font_T* font);
+
+void font_close(font_T* font);
+
+uint64_t font_get_file_hash(font_T* font);
+
+FT_Face font_lock(font_T* font);
+
+void font_unlock(font_T* font);
+#endif
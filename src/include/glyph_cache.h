@@ -0,0 +1,69 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+#include <stdint.h>
+#include "character.h"
+
+
+#define GLYPH_TABLE_LATIN1_SIZE 256
+#define GLYPH_TABLE_PAGE_SIZE 256     // Codepoints per page, must be a power of two
+#define GLYPH_TABLE_PAGE_SHIFT 8
+#define GLYPH_TABLE_PAGES (0x110000 >> GLYPH_TABLE_PAGE_SHIFT)
+#define GLYPH_ID_PENDING (GLYPH_ID_NONE - 1)   // Submitted to the raster pool, not added yet
+#define GLYPH_CACHE_UNLIMITED -1.0    // Frame budget that never defers rasterization
+
+/**
+ * Glyph IDs of one font by codepoint.
+ * Latin-1 is a flat array, everything above it goes through a directory
+ * of pages that are only allocated once a codepoint inside of them is used.
+ * Unused entries hold GLYPH_ID_NONE.
+ */
+typedef struct GLYPH_TABLE_STRUCT
+{
+    glyph_id_T latin1[GLYPH_TABLE_LATIN1_SIZE];
+    glyph_id_T** pages;       // Directory indexed by codepoint >> GLYPH_TABLE_PAGE_SHIFT
+    size_t pages_size;        // Length of the directory, grown on demand
+    glyph_id_T placeholder;   // Returned for glyphs that are still being rasterized
+} glyph_table_T;
+
+typedef struct GLYPH_CACHE_STATS_STRUCT
+{
+    unsigned long hits;
+    unsigned long misses;     // Every miss is one rasterization
+    size_t size;              // Amount of cached glyphs
+    size_t pages;             // Amount of allocated table pages
+    size_t pending;           // Glyphs still being rasterized by the raster pool
+    unsigned long evictions;  // Glyphs dropped to keep the atlas under its budget
+} glyph_cache_stats_T;
+
+glyph_table_T* glyph_cache_new_table(font_T* font);
+
+void glyph_cache_free_table(glyph_table_T* table);
+
+glyph_id_T glyph_cache_get(font_T* font, uint32_t codepoint);
+
+void glyph_cache_insert(font_T* font, uint32_t codepoint, glyph_id_T glyph);
+
+size_t glyph_cache_list(font_T* font, uint32_t* codepoints, glyph_id_T* glyphs, size_t max);
+
+void glyph_cache_warm(font_T* font, const uint32_t* codepoints, size_t count);
+
+void glyph_cache_set_atlas_budget(size_t bytes);
+
+void glyph_cache_pin(font_T* font, const uint32_t* codepoints, size_t count);
+
+void glyph_cache_unpin(font_T* font, const uint32_t* codepoints, size_t count);
+
+void glyph_cache_touch(const glyph_id_T* glyphs, size_t count);
+
+void glyph_cache_set_frame_budget(double milliseconds);
+
+void glyph_cache_set_repack_budget(double milliseconds);
+
+void glyph_cache_update();
+
+unsigned long glyph_cache_get_generation();
+
+glyph_cache_stats_T glyph_cache_get_stats();
+
+void glyph_cache_reset_stats();
+#endif
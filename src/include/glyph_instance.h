@@ -0,0 +1,51 @@
+#ifndef GLYPH_INSTANCE_H
+#define GLYPH_INSTANCE_H
+#include <GL/glew.h>
+#include <stdint.h>
+#include "glyph_store.h"
+
+
+#define GLYPH_INSTANCE_STRIDE sizeof(struct GLYPH_INSTANCE_STRUCT)
+#define GLYPH_INSTANCE_QUAD_VERTICES 4  // Triangle strip expanded from gl_VertexID
+
+// Packs a color into the byte order expected by the color attribute
+#define GLYPH_INSTANCE_RGBA(r, g, b, a) \
+    ((uint32_t)(r) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(a) << 24))
+
+/**
+ * Everything the vertex shader needs to expand one glyph quad.
+ */
+typedef struct GLYPH_INSTANCE_STRUCT
+{
+    GLfloat x;        // Bottom left corner of the quad
+    GLfloat y;
+    GLfloat width;
+    GLfloat height;
+    GLfloat u0;       // UV rectangle inside the atlas page
+    GLfloat v0;
+    GLfloat u1;
+    GLfloat v1;
+    uint32_t color;   // RGBA8, see GLYPH_INSTANCE_RGBA
+    GLfloat phase;
+} glyph_instance_T;
+
+/**
+ * Attribute locations of the instance inputs of a text program.
+ */
+typedef struct GLYPH_INSTANCE_LAYOUT_STRUCT
+{
+    GLint rect_location;
+    GLint uv_location;
+    GLint color_location;
+    GLint phase_location;
+    GLint format_location;    // Uniform set to the ATLAS_FORMAT_* of the page drawn
+} glyph_instance_layout_T;
+
+glyph_instance_layout_T glyph_instance_get_layout(GLuint program);
+
+void glyph_instance_setup_vao(glyph_instance_layout_T* layout, GLuint VAO);
+
+void glyph_instance_draw(glyph_instance_layout_T* layout, GLuint VBO, size_t offset, unsigned int page, size_t count);
+
+int glyph_instance_init(glyph_instance_T* instance, glyph_id_T glyph, float x, float y, float scale, uint32_t color, float phase);
+#endif
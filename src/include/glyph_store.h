@@ -0,0 +1,45 @@
+#ifndef GLYPH_STORE_H
+#define GLYPH_STORE_H
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef uint32_t glyph_id_T;
+
+#define GLYPH_ID_NONE UINT32_MAX
+
+struct GLYPH_TABLE_STRUCT;
+
+/**
+ * Metrics and atlas placement of every cached glyph as parallel arrays,
+ * indexed by dense glyph IDs so layout loops stream through contiguous memory.
+ */
+typedef struct GLYPH_STORE_STRUCT
+{
+    int16_t* advance;         // Whole pixels to the next glyph
+    int16_t* bearing_left;
+    int16_t* bearing_top;
+    uint16_t* width;
+    uint16_t* height;
+    uint16_t* atlas_x;        // Position of the bitmap inside its atlas page
+    uint16_t* atlas_y;
+    uint16_t* page;
+    uint32_t* codepoint;      // Key of the glyph inside its table
+    struct GLYPH_TABLE_STRUCT** table;    // Table the glyph is cached in, null for placeholders and freed IDs
+    uint32_t* last_used;      // Glyph cache frame the glyph was last used in
+    uint8_t* pinned;          // Never evicted while set
+    size_t size;              // IDs handed out so far, including freed ones
+    size_t capacity;
+    glyph_id_T* free_ids;     // Freed IDs, reused before new ones are handed out
+    size_t free_ids_size;
+    size_t free_ids_capacity;
+} glyph_store_T;
+
+glyph_store_T* glyph_store_get();
+
+glyph_id_T glyph_store_add();
+
+void glyph_store_remove(glyph_id_T id);
+
+void glyph_store_free();
+#endif
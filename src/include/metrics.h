@@ -0,0 +1,60 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "font.h"
+
+
+/**
+ * Placement of a glyph in pixels, measured from its outline
+ * without rendering a bitmap or touching OpenGL.
+ */
+typedef struct GLYPH_METRICS_STRUCT
+{
+    int advance;      // Horizontal offset to the next glyph, 26.6 fixed point
+    int bearing_left;
+    int bearing_top;
+    int width;
+    int height;
+} glyph_metrics_T;
+
+typedef struct METRICS_SLOT_STRUCT
+{
+    uint32_t key;     // Codepoint + 1, 0 marks an empty slot
+    glyph_metrics_T metrics;
+} metrics_slot_T;
+
+/**
+ * Metrics measured so far for one font, safe to use from any thread.
+ */
+typedef struct METRICS_TABLE_STRUCT
+{
+    metrics_slot_T* slots;
+    size_t capacity;
+    size_t size;
+    pthread_mutex_t lock;
+} metrics_table_T;
+
+typedef struct TEXT_METRICS_STRUCT
+{
+    float width;      // Advance width of the text
+    float ascent;     // Highest ink above the baseline
+    float descent;    // Lowest ink below the baseline, as a positive distance
+    size_t length;    // Bytes of the measured text
+} text_metrics_T;
+
+metrics_table_T* metrics_new_table();
+
+void metrics_free_table(metrics_table_T* table);
+
+glyph_metrics_T metrics_get_glyph(font_T* font, uint32_t codepoint);
+
+void metrics_set_glyph(font_T* font, uint32_t codepoint, glyph_metrics_T metrics);
+
+text_metrics_T measure_string(font_T* font, const char* text, float scale);
+
+size_t measure_lines(font_T* font, const char* text, float scale, text_metrics_T* lines, size_t max_lines);
+
+float metrics_get_line_height(font_T* font, float scale);
+#endif
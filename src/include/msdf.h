@@ -0,0 +1,52 @@
+#ifndef MSDF_H
+#define MSDF_H
+#include <stddef.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+
+
+#define MSDF_SPREAD 4     // Pixels of distance encoded on each side of the edge
+
+// Channels an edge contributes to, combined as bits
+#define MSDF_RED 1
+#define MSDF_GREEN 2
+#define MSDF_BLUE 4
+#define MSDF_WHITE (MSDF_RED | MSDF_GREEN | MSDF_BLUE)
+
+#define MSDF_CORNER_ANGLE 3.0     // Radians, sharper turns between edges are corners
+
+typedef struct MSDF_POINT_STRUCT
+{
+    double x;
+    double y;
+} msdf_point_T;
+
+/**
+ * A line, quadratic or cubic Bezier segment of an outline in pixels, y pointing up.
+ */
+typedef struct MSDF_EDGE_STRUCT
+{
+    msdf_point_T p[4];
+    int degree;       // 1 line, 2 quadratic, 3 cubic
+    int color;        // MSDF_* channels the edge contributes to
+    msdf_point_T min; // Box around the control points, which also contains the edge
+    msdf_point_T max;
+} msdf_edge_T;
+
+/**
+ * The edges of an outline, grouped into closed contours.
+ */
+typedef struct MSDF_SHAPE_STRUCT
+{
+    msdf_edge_T* edges;
+    size_t edges_size;
+    size_t edges_capacity;
+    size_t* contours;         // First edge of every contour
+    size_t contours_size;
+    size_t contours_capacity;
+    msdf_point_T position;    // Pen position while decomposing
+} msdf_shape_T;
+
+unsigned char* msdf_generate(FT_Outline* outline, int left, int top, int width, int rows, int spread);
+#endif
@@ -0,0 +1,60 @@
+#ifndef RASTER_POOL_H
+#define RASTER_POOL_H
+#include <stdint.h>
+#include <pthread.h>
+#include "font.h"
+#include "character.h"
+
+
+#define RASTER_POOL_MAX_WORKERS 32
+
+/**
+ * One glyph to rasterize off the GL thread.
+ * Created by raster_pool_submit, filled in by a worker
+ * and handed back by raster_pool_collect.
+ */
+typedef struct RASTER_JOB_STRUCT
+{
+    struct RASTER_JOB_STRUCT* next;
+    font_T* font;             // Retained until the job is released
+    uint32_t codepoint;
+    glyph_bitmap_T bitmap;    // Tightly packed copy owned by the job
+} raster_job_T;
+
+/**
+ * FreeType face a worker opened on the mapping of a shared face.
+ */
+typedef struct RASTER_WORKER_FACE_STRUCT
+{
+    font_face_T* face;
+    FT_Face ft_face;
+    int pixel_size;           // Size currently set on ft_face
+} raster_worker_face_T;
+
+/**
+ * A worker thread with FreeType objects of its own,
+ * so workers never contend on the locks of the shared faces.
+ */
+typedef struct RASTER_WORKER_STRUCT
+{
+    pthread_t thread;
+    pthread_mutex_t lock;     // Held while the worker uses its FreeType objects
+    FT_Library library;
+    raster_worker_face_T* faces;
+    size_t faces_size;
+} raster_worker_T;
+
+void raster_pool_start(int workers);
+
+int raster_pool_running();
+
+void raster_pool_submit(font_T* font, uint32_t codepoint);
+
+raster_job_T* raster_pool_collect(int wait);
+
+void raster_pool_release(raster_job_T* job);
+
+void raster_pool_forget_face(font_face_T* face);
+
+void raster_pool_stop();
+#endif
@@ -0,0 +1,10 @@
+#ifndef SDF_H
+#define SDF_H
+#include <stddef.h>
+
+
+#define SDF_SPREAD 8      // Pixels of distance encoded on each side of the edge
+#define SDF_EDGE 128      // Encoded value right on the outline
+
+unsigned char* sdf_generate(const unsigned char* coverage, int width, int rows, int pitch, int spread);
+#endif
@@ -0,0 +1,35 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+#include <GL/glew.h>
+#include <stddef.h>
+
+
+#define STREAM_BUFFER_REGIONS 3   // Frames the CPU may run ahead of the GPU
+
+/**
+ * One buffer object split into frame sized regions that are written
+ * round-robin, each region guarded by a fence so the CPU never
+ * overwrites vertices the GPU has yet to read.
+ */
+typedef struct STREAM_BUFFER_STRUCT
+{
+    GLuint buffer;
+    GLenum target;
+    size_t region_size;
+    unsigned int region;      // Region being written this frame
+    size_t offset;            // Write offset inside the current region
+    GLsync fences[STREAM_BUFFER_REGIONS];
+    unsigned char* persistent;  // Whole buffer when persistently mapped, else NULL
+    int mapped;
+} stream_buffer_T;
+
+stream_buffer_T* init_stream_buffer(GLenum target, size_t region_size);
+
+void* stream_buffer_map(stream_buffer_T* stream, size_t bytes, size_t alignment, size_t* offset);
+
+void stream_buffer_unmap(stream_buffer_T* stream);
+
+void stream_buffer_end_frame(stream_buffer_T* stream);
+
+void stream_buffer_free(stream_buffer_T* stream);
+#endif
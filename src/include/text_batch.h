@@ -0,0 +1,52 @@
+#ifndef TEXT_BATCH_H
+#define TEXT_BATCH_H
+#include <GL/glew.h>
+#include <stdint.h>
+#include "character.h"
+#include "glyph_instance.h"
+#include "stream_buffer.h"
+
+
+#define TEXT_BATCH_REGION_SIZE (4096 * GLYPH_INSTANCE_STRIDE)
+
+/**
+ * Glyph instances collected for a single atlas page.
+ */
+typedef struct TEXT_BATCH_PAGE_STRUCT
+{
+    glyph_instance_T* instances;
+    size_t size;
+    size_t capacity;
+} text_batch_page_T;
+
+/**
+ * Immediate mode text: everything added between begin and flush
+ * is streamed to the GPU and drawn once.
+ */
+typedef struct TEXT_BATCH_STRUCT
+{
+    GLuint VAO;
+    stream_buffer_T* stream;
+    glyph_instance_layout_T layout;
+    uint32_t color;         // Color given to glyphs added from now on
+    text_batch_page_T* pages;   // Indexed by atlas page
+    size_t pages_size;
+    glyph_run_T run;        // Glyphs of the string being added, reused between strings
+} text_batch_T;
+
+text_batch_T* init_text_batch(GLuint program);
+
+void text_batch_begin(text_batch_T* batch);
+
+void text_batch_set_color(text_batch_T* batch, uint32_t color);
+
+void text_batch_add_glyph(text_batch_T* batch, glyph_id_T glyph, float x, float y, float scale, float phase);
+
+float text_batch_add_string(text_batch_T* batch, font_T* font, const char* text, float x, float y, float scale);
+
+void text_batch_flush(text_batch_T* batch);
+
+void text_batch_end_frame(text_batch_T* batch);
+
+void text_batch_free(text_batch_T* batch);
+#endif
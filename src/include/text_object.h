@@ -0,0 +1,85 @@
+#ifndef TEXT_OBJECT_H
+#define TEXT_OBJECT_H
+#include <GL/glew.h>
+#include <stdint.h>
+#include "font.h"
+#include "glyph_instance.h"
+#include "upload_thread.h"
+
+
+#define TEXT_OBJECT_MIN_CAPACITY 16   // Instances reserved for an object at the least
+
+/**
+ * A string that stays on screen between frames.
+ * Its layout and its range of the renderer's instance buffer are kept
+ * and only rebuilt after the text or its position changed.
+ */
+typedef struct TEXT_OBJECT_STRUCT
+{
+    font_T* font;
+    char* text;
+    float x;
+    float y;
+    float scale;
+    uint32_t color;
+    float width;      // Advance width of the laid out text
+    glyph_instance_T* instances;    // Cached layout, sorted by atlas page
+    size_t instances_size;
+    size_t instances_capacity;
+    size_t* page_counts;    // Instances per atlas page
+    size_t page_counts_size;
+    glyph_id_T* glyphs;       // Glyphs of the cached layout, kept from being evicted while drawn
+    size_t glyphs_size;
+    size_t offset;            // First instance inside the renderer buffer
+    size_t capacity;          // Instances reserved inside the renderer buffer
+    size_t uploaded_size;     // Instances written to the buffer by the last upload
+    int layout_dirty;         // Text changed, glyphs must be laid out again
+    int dirty;                // Instances changed, range must be uploaded again
+    int placeholders;         // Layout used placeholders of glyphs still being rasterized
+    int shown;                // Drawn at least once, later uploads stay on the render thread so it never blinks
+    upload_job_T* upload;     // First upload running on the upload thread, the object is not drawn meanwhile
+    unsigned long glyph_generation;   // Glyph cache generation the layout was made with
+    unsigned long atlas_relocations;  // atlas_get_relocations() the layout was made with
+} text_object_T;
+
+/**
+ * Instances of the renderer buffer no object holds, draws never reach into them.
+ */
+typedef struct TEXT_RANGE_STRUCT
+{
+    size_t offset;
+    size_t size;
+} text_range_T;
+
+typedef struct TEXT_RENDERER_STRUCT
+{
+    GLuint VAO;
+    GLuint VBO;
+    size_t VBO_capacity;    // Instances
+    size_t VBO_size;        // Instances up to the end of the last range handed out
+    text_range_T* free_ranges;    // Released below VBO_size, ordered by offset and never touching
+    size_t free_ranges_size;
+    size_t free_ranges_capacity;
+    glyph_instance_layout_T layout;
+    text_object_T** objects;    // Ordered by offset
+    size_t objects_size;
+} text_renderer_T;
+
+text_renderer_T* init_text_renderer(GLuint program);
+
+text_object_T* init_text_object(text_renderer_T* renderer, font_T* font, const char* text, float x, float y, float scale);
+
+void text_object_set_text(text_object_T* object, const char* text);
+
+void text_object_set_position(text_object_T* object, float x, float y);
+
+void text_object_set_color(text_object_T* object, uint32_t color);
+
+float text_object_get_width(text_object_T* object);
+
+void text_renderer_draw(text_renderer_T* renderer);
+
+void text_object_free(text_renderer_T* renderer, text_object_T* object);
+
+void text_renderer_free(text_renderer_T* renderer);
+#endif
@@ -0,0 +1,40 @@
+#ifndef UPLOAD_THREAD_H
+#define UPLOAD_THREAD_H
+#include <GL/glew.h>
+#include <pthread.h>
+
+
+struct GLFWwindow;
+
+#define UPLOAD_JOB_QUEUED 0       // Waiting for the upload thread
+#define UPLOAD_JOB_SUBMITTED 1    // Commands issued and fenced, the GPU may still be executing them
+#define UPLOAD_JOB_DONE 2         // The GPU executed the commands, the render thread may use the objects
+
+/**
+ * GL commands run on the upload thread's context.
+ * Created by upload_thread_submit, polled with upload_job_done
+ * and handed back with upload_job_release.
+ */
+typedef struct UPLOAD_JOB_STRUCT
+{
+    struct UPLOAD_JOB_STRUCT* next;
+    void (*run)(void* data);  // Issues the commands, called on the upload thread
+    void* data;               // Owned by the job, freed on release
+    GLsync fence;             // Signaled once the GPU executed the commands
+    int state;                // UPLOAD_JOB_*, guarded by the queue lock
+} upload_job_T;
+
+int upload_thread_start(struct GLFWwindow* context);
+
+int upload_thread_running();
+
+upload_job_T* upload_thread_submit(void (*run)(void* data), void* data);
+
+int upload_job_done(upload_job_T* job);
+
+void upload_job_wait(upload_job_T* job);
+
+void upload_job_release(upload_job_T* job);
+
+void upload_thread_stop();
+#endif
@@ -0,0 +1,12 @@
+#ifndef UTF8_H
+#define UTF8_H
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define UTF8_REPLACEMENT 0xFFFD   // Returned for malformed sequences
+
+uint32_t utf8_decode(const char** text);
+
+size_t utf8_decode_string(const char* text, size_t length, uint32_t* codepoints);
+#endif
@@ -6,6 +6,16 @@
 #include <math.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include "include/font.h"
+#include "include/character.h"
+#include "include/glyph_cache.h"
+#include "include/raster_pool.h"
+#include "include/atlas.h"
+#include "include/atlas_cache.h"
+#include "include/baked.h"
+#include "include/text_object.h"
+#include "include/metrics.h"
+#include "include/upload_thread.h"
 
 
 /**
@@ -25,109 +35,6 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
         glfwSetWindowShouldClose(window, GLFW_TRUE);
 }
 
-typedef struct CHARACTER_STRUCT
-{
-    GLuint texture;   // ID handle of the glyph texture
-    vec2 size;    // Size of glyph
-    float width;
-    float height;
-    float bearing_left;
-    float bearing_top;
-    GLuint advance;    // Horizontal offset to advance to next glyph
-} character_T;
-
-typedef struct CHARACTER_LIST_STRUCT
-{
-    size_t size;
-    character_T** items;
-} character_list_T;
-
-character_T* get_character(char c, const char* fontpath, int size)
-{
-    // FreeType
-    FT_Library ft;
-    // All functions return a value different than 0 whenever an error occurred
-    if (FT_Init_FreeType(&ft))
-        perror("ERROR::FREETYPE: Could not init FreeType Library");
-
-    // Load font as face
-    FT_Face face;
-    if (FT_New_Face(ft, fontpath, 0, &face))
-        perror("ERROR::FREETYPE: Failed to load font");
-
-    // Set size to load glyphs as
-    FT_Set_Pixel_Sizes(face, 0, size);
-
-    // Disable byte-alignment restriction
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); 
-
-    // Load character glyph 
-    if (FT_Load_Char(face, c, FT_LOAD_RENDER))
-        perror("ERROR::FREETYTPE: Failed to load Glyph");
-
-    // Generate texture
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RED,
-        face->glyph->bitmap.width,
-        face->glyph->bitmap.rows,
-        0,
-        GL_RED,
-        GL_UNSIGNED_BYTE,
-        face->glyph->bitmap.buffer
-    );
-    // Set texture options
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    // Now store character for later use
-    character_T* character = calloc(1, sizeof(struct CHARACTER_STRUCT));
-    character->texture = texture;
-    character->width = face->glyph->bitmap.width;
-    character->height = face->glyph->bitmap.rows;
-    character->bearing_left = face->glyph->bitmap_left;
-    character->bearing_top = face->glyph->bitmap_top;
-    character->advance = face->glyph->advance.x;
-    glBindTexture(GL_TEXTURE_2D, 0);
-    // Destroy FreeType once we're finished
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft); 
-
-    return character;
-}
-
-static character_list_T get_characters(const char* text, const char* fontpath, int size)
-{
-    character_list_T list;
-    list.size = 0;
-    list.items = (void*)0;
-
-    for (int i = 0; i < strlen(text); i++)
-    {
-        character_T* character = get_character(text[i], fontpath, size);
-
-        list.size += 1;
-
-        if (list.items == (void*)0)
-        {
-            list.items = calloc(list.size, sizeof(struct CHARACTER_STRUCT*));
-        }
-        else
-        {
-            list.items = realloc(list.items, sizeof(struct CHARACTER_STRUCT*) * list.size);
-        }
-
-        list.items[list.size - 1] = character;
-    }
-
-    return list;
-}
-
 int main(int argc, char* argv[])
 {
     glfwSetErrorCallback(error_callback);
@@ -171,17 +78,23 @@ int main(int argc, char* argv[])
 
     fprintf(stdout, "Status: Using GLEW %s\n", glewGetString(GLEW_VERSION));
 
+    /**
+     * New glyphs and the first upload of every text are written by a thread of their own,
+     * through an invisible window whose context shares objects with this one.
+     * Without it every upload happens right here on the render thread.
+     */
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* upload_window = glfwCreateWindow(1, 1, "Uploads", NULL, window);
+
+    if (!upload_thread_start(upload_window))
+        fprintf(stderr, "Warning: Uploading on the render thread\n");
+
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     
-    unsigned int VAO;
-    glGenVertexArrays(1, &VAO);
-
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-
     GLuint vertex_shader, fragment_shader, program;
-    GLint mvp_location, vertex_location;
+    GLint mvp_location;
+    GLint time_location, amplitude_location, frequency_location;
 
     /**
      * Vertex Shader
@@ -189,26 +102,47 @@ int main(int argc, char* argv[])
     static const char* vertex_shader_text =
         "#version 330 core\n"
         "uniform mat4 MVP;\n"
-        "attribute vec4 thevertex;\n"
+        "uniform float time;\n"
+        "uniform float amplitude;\n"
+        "uniform float frequency;\n"
+        "in vec4 rect;\n"
+        "in vec4 uv_rect;\n"
+        "in vec4 color;\n"
+        "in float phase;\n"
         "out vec2 TexCoord;\n"
+        "out vec4 Color;\n"
         "void main()\n"
         "{\n"
-        "    gl_Position = MVP * vec4(thevertex.xy, 0.0, 1.0);\n"
-        "    TexCoord = thevertex.zw;"
+        "    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+        "    vec2 position = rect.xy + corner * rect.zw;\n"
+        "    float wobble = sin((time + phase) * frequency) * amplitude;\n"
+        "    gl_Position = MVP * vec4(position.x, position.y + wobble, 0.0, 1.0);\n"
+        "    TexCoord = vec2(mix(uv_rect.x, uv_rect.z, corner.x), mix(uv_rect.w, uv_rect.y, corner.y));\n"
+        "    Color = color;\n"
         "}\n";
     
     /**
-     * Fragment Shader
+     * Fragment Shader, pages in ATLAS_FORMAT_SDF hold distance fields with the edge at SDF_EDGE
+     * and pages in ATLAS_FORMAT_MSDF three fields whose median is the distance.
+     * Edges are antialiased over one screen pixel using how fast the distance changes across it
      */    
     static const char* fragment_shader_text =
         "#version 330 core\n"
-        "varying vec3 color;\n"
         "in vec2 TexCoord;\n"
+        "in vec4 Color;\n"
         "uniform sampler2D ourTexture;\n"
+        "uniform int format;\n"
         "void main()\n"
         "{\n"
-        "    vec4 sampled = vec4(1.0, 1.0, 1.0, texture(ourTexture, TexCoord).r);\n"
-        "    gl_FragColor = vec4(vec3(1, 1, 1), 1.0) * sampled;\n"
+        "    vec3 texel = texture(ourTexture, TexCoord).rgb;\n"
+        "    float median = max(min(texel.r, texel.g), min(max(texel.r, texel.g), texel.b));\n"
+        "    float value = format == 2 ? median : texel.r;\n"
+        "    float alpha = value;\n"
+        "    float width = length(vec2(dFdx(value), dFdy(value)));\n"
+        "    if (format != 0)\n"
+        "        alpha = clamp((value - 128.0 / 255.0) / max(width, 1e-4) + 0.5, 0.0, 1.0);\n"
+        "    vec4 sampled = vec4(1.0, 1.0, 1.0, alpha);\n"
+        "    gl_FragColor = Color * sampled;\n"
         "}\n"; 
 
     int success;
@@ -259,12 +193,78 @@ int main(int argc, char* argv[])
     /**
      * Grab locations from shader
      */
-    vertex_location = glGetAttribLocation(program, "thevertex");
     mvp_location = glGetUniformLocation(program, "MVP");
+    time_location = glGetUniformLocation(program, "time");
+    amplitude_location = glGetUniformLocation(program, "amplitude");
+    frequency_location = glGetUniformLocation(program, "frequency");
+
+    text_renderer_T* renderer = init_text_renderer(program);
 
-    glBindVertexArray(VAO);
+    font_T* font;
+    baked_atlas_T* baked = (void*)0;
 
-    character_list_T character_list = get_characters("OMNUM", "/usr/share/fonts/truetype/gentium/GentiumAlt-R.ttf", 72); 
+    if (argc > 1)
+    {
+        /**
+         * Render only from a file baked by fontbake, FreeType is never initialized
+         */
+        baked = baked_load_file(argv[1]);
+        font = baked ? baked_find_font(baked, (void*)0, 0) : (void*)0;
+
+        if (font == (void*)0)
+        {
+            fprintf(stderr, "Error: No font baked into %s\n", argv[1]);
+            return 1;
+        }
+    }
+    else
+    {
+        font = font_open("/usr/share/fonts/truetype/gentium/GentiumAlt-R.ttf", 0, 72, FONT_MODE_MSDF);
+
+        // Long runs through many scripts keep the atlas to a few pages, least recently used glyphs make room
+        glyph_cache_set_atlas_budget(16 << 20);
+
+        /**
+         * Glyphs cached by earlier runs are uploaded without FreeType,
+         * the printable Latin-1 set is rasterized up front on every core and never evicted
+         */
+        size_t glyphs_loaded = atlas_cache_load(font, atlas_cache_get_directory());
+
+        raster_pool_start(0);
+
+        uint32_t charset[192];
+        size_t charset_size = 0;
+        for (uint32_t c = 0x20; c <= 0xFF; c++)
+        {
+            if (c < 0x7F || c >= 0xA0)
+                charset[charset_size++] = c;
+        }
+
+        glyph_cache_pin(font, charset, charset_size);
+
+        if (glyph_cache_get_stats().size > glyphs_loaded)
+            atlas_cache_save(font, atlas_cache_get_directory());
+    }
+
+    // Glyphs missing later on must not stall the frame
+    glyph_cache_set_frame_budget(2.0);
+
+    // Pages thinned out by eviction are merged back a little every frame
+    glyph_cache_set_repack_budget(0.5);
+
+    /**
+     * The text never changes, it is laid out and uploaded once centered
+     * around the origin and only the time uniform animates it.
+     */
+    text_metrics_T title_metrics = measure_string(font, "OMNUM", 1.0f);
+    init_text_object(renderer, font, "OMNUM", -(title_metrics.width / 2), 0, 1.0f);
+
+    glUseProgram(program);
+    glUniform1f(amplitude_location, 16.0f);
+    glUniform1f(frequency_location, 5.0f);
+
+    glyph_cache_stats_T cache_stats = glyph_cache_get_stats();
+    fprintf(stdout, "Glyph cache: %lu hits, %lu misses\n", cache_stats.hits, cache_stats.misses);
 
     /**
      * Main loop
@@ -282,7 +282,14 @@ int main(int argc, char* argv[])
         
         mat4 m = GLM_MAT4_IDENTITY_INIT; 
 
-        glm_translate(m, (vec3){ 0, 0, 0 });
+        glm_translate(m, (vec3){ width / 2, height / 2, 0 });
+
+        // Distance fields stay sharp at any zoom without rasterizing again
+        if (font->mode != FONT_MODE_BITMAP)
+        {
+            float zoom = 1.0f + 0.5f * sin(t * 0.5);
+            glm_scale(m, (vec3){ zoom, zoom, 1 });
+        }
         
         glm_ortho(0.0f, width, 0, height, -10.0f, 100.0f, p);
         glm_mat4_mul(p, m, mvp);
@@ -290,60 +297,35 @@ int main(int argc, char* argv[])
         glUseProgram(program);
         glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat*) mvp);
 
+        glUniform1f(time_location, t);
 
-        float scale = 1.0f;
-
-        float full_text_width = 0;
-        for (int i = 0; i < character_list.size; i++)
-        {
-            character_T* character = character_list.items[i];
-            full_text_width += character->bearing_left * scale;
-            full_text_width += (character->advance >> 6) * scale;
-        }
+        glyph_cache_update();
 
         /**
-         * Draw texture
+         * Draw text
          */
-        float x = width / 2;
-        float y = height / 2;
-        for (int i = 0; i < character_list.size; i++)
-        {
-            character_T* character = character_list.items[i];
-            unsigned int texture = character->texture;
-
-            GLfloat xpos = x + ((character->bearing_left * scale) - (full_text_width/2));
-            GLfloat ypos = y - (character->height - character->bearing_top) * scale;
-            ypos = ypos + sin((t+i) *  5.0f) * 16.0f;
-
-            GLfloat w = character->width * scale;
-            GLfloat h = character->height * scale;
-
-            GLfloat vertices[6][4] = {
-                { xpos,     ypos + h,   0.0, 0.0 },            
-                { xpos,     ypos,       0.0, 1.0 },
-                { xpos + w, ypos,       1.0, 1.0 },
-
-                { xpos,     ypos + h,   0.0, 0.0 },
-                { xpos + w, ypos,       1.0, 1.0 },
-                { xpos + w, ypos + h,   1.0, 0.0 }           
-            };
-
-            glActiveTexture(GL_TEXTURE0);
-            glBindVertexArray(VAO);
-            glBindTexture(GL_TEXTURE_2D, texture);
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, vertices, GL_STATIC_DRAW);
-            glEnableVertexAttribArray(vertex_location);
-            glVertexAttribPointer(vertex_location, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-
-            x += (character->advance >> 6) * scale;
-        }
+        text_renderer_draw(renderer);
+        atlas_end_frame();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
    
+    raster_pool_stop();
+    upload_thread_stop();
+    atlas_cache_save(font, atlas_cache_get_directory());
+    text_renderer_free(renderer);
+    font_close(font);
+
+    if (baked != (void*)0)
+        baked_free(baked);
+
+    glyph_store_free();
+    atlas_free();
+
+    if (upload_window != (void*)0)
+        glfwDestroyWindow(upload_window);
+
     glfwDestroyWindow(window); 
     glfwTerminate();
     return 0;
@@ -0,0 +1,263 @@
+#include "include/metrics.h"
+#include "include/character.h"
+#include "include/utf8.h"
+#include <stdlib.h>
+#include <string.h>
+#include FT_OUTLINE_H
+
+
+#define METRICS_INITIAL_CAPACITY 128
+
+metrics_table_T* metrics_new_table()
+{
+    metrics_table_T* table = calloc(1, sizeof(struct METRICS_TABLE_STRUCT));
+    pthread_mutex_init(&table->lock, (void*)0);
+
+    return table;
+}
+
+void metrics_free_table(metrics_table_T* table)
+{
+    pthread_mutex_destroy(&table->lock);
+    free(table->slots);
+    free(table);
+}
+
+static size_t metrics_hash(uint32_t key)
+{
+    key ^= key >> 16;
+    key *= 0x7feb352d;
+    key ^= key >> 15;
+    key *= 0x846ca68b;
+    key ^= key >> 16;
+
+    return key;
+}
+
+static metrics_slot_T* metrics_find(metrics_table_T* table, uint32_t key)
+{
+    if (table->capacity == 0)
+        return (void*)0;
+
+    size_t mask = table->capacity - 1;
+    size_t i = metrics_hash(key) & mask;
+
+    while (table->slots[i].key != 0)
+    {
+        if (table->slots[i].key == key)
+            return &table->slots[i];
+
+        i = (i + 1) & mask;
+    }
+
+    return (void*)0;
+}
+
+static void metrics_place(metrics_slot_T* slots, size_t capacity, metrics_slot_T slot)
+{
+    size_t mask = capacity - 1;
+    size_t i = metrics_hash(slot.key) & mask;
+
+    while (slots[i].key != 0)
+        i = (i + 1) & mask;
+
+    slots[i] = slot;
+}
+
+static void metrics_insert(metrics_table_T* table, uint32_t key, glyph_metrics_T metrics)
+{
+    // Another thread may have measured the same glyph meanwhile
+    if (metrics_find(table, key) != (void*)0)
+        return;
+
+    if ((table->size + 1) * 2 > table->capacity)
+    {
+        size_t capacity = table->capacity ? table->capacity * 2 : METRICS_INITIAL_CAPACITY;
+        metrics_slot_T* slots = calloc(capacity, sizeof(struct METRICS_SLOT_STRUCT));
+
+        for (size_t i = 0; i < table->capacity; i++)
+        {
+            if (table->slots[i].key != 0)
+                metrics_place(slots, capacity, table->slots[i]);
+        }
+
+        free(table->slots);
+        table->slots = slots;
+        table->capacity = capacity;
+    }
+
+    metrics_slot_T slot;
+    slot.key = key;
+    slot.metrics = metrics;
+
+    metrics_place(table->slots, table->capacity, slot);
+    table->size += 1;
+}
+
+/**
+ * Loads the outline of a glyph with the flags it is rasterized with
+ * and derives the box the rasterizer would produce, no bitmap is rendered.
+ */
+static glyph_metrics_T metrics_load(font_T* font, uint32_t codepoint)
+{
+    glyph_metrics_T metrics;
+    memset(&metrics, 0, sizeof(struct GLYPH_METRICS_STRUCT));
+
+    // Baked fonts only know the glyphs they were baked with
+    if (font->face == (void*)0)
+        return metrics;
+
+    FT_Face face = font_lock(font);
+
+    // Hinting changes advances, they must match the glyphs the font is drawn with
+    if (FT_Load_Char(face, codepoint, character_get_load_flags(font) & ~FT_LOAD_RENDER))
+    {
+        font_unlock(font);
+        return metrics;
+    }
+
+    FT_GlyphSlot glyph = face->glyph;
+    metrics.advance = glyph->advance.x;
+
+    if (glyph->format == FT_GLYPH_FORMAT_OUTLINE)
+    {
+        FT_BBox box;
+        FT_Outline_Get_CBox(&glyph->outline, &box);
+
+        // Grid fit the same way the rasterizer does
+        box.xMin &= ~63;
+        box.yMin &= ~63;
+        box.xMax = (box.xMax + 63) & ~63;
+        box.yMax = (box.yMax + 63) & ~63;
+
+        metrics.bearing_left = box.xMin >> 6;
+        metrics.bearing_top = box.yMax >> 6;
+        metrics.width = (box.xMax - box.xMin) >> 6;
+        metrics.height = (box.yMax - box.yMin) >> 6;
+    }
+    else
+    {
+        metrics.bearing_left = glyph->metrics.horiBearingX >> 6;
+        metrics.bearing_top = glyph->metrics.horiBearingY >> 6;
+        metrics.width = glyph->metrics.width >> 6;
+        metrics.height = glyph->metrics.height >> 6;
+    }
+
+    font_unlock(font);
+
+    return metrics;
+}
+
+/**
+ * Returns the metrics of a glyph, measuring it on first use.
+ * Safe to call from any thread, no OpenGL context is needed.
+ */
+glyph_metrics_T metrics_get_glyph(font_T* font, uint32_t codepoint)
+{
+    metrics_table_T* table = font->metrics;
+    uint32_t key = codepoint + 1;
+
+    pthread_mutex_lock(&table->lock);
+    metrics_slot_T* slot = metrics_find(table, key);
+
+    if (slot != (void*)0)
+    {
+        glyph_metrics_T metrics = slot->metrics;
+        pthread_mutex_unlock(&table->lock);
+        return metrics;
+    }
+
+    pthread_mutex_unlock(&table->lock);
+
+    // The table is not held while FreeType works, other lookups keep going
+    glyph_metrics_T metrics = metrics_load(font, codepoint);
+
+    pthread_mutex_lock(&table->lock);
+    metrics_insert(table, key, metrics);
+    pthread_mutex_unlock(&table->lock);
+
+    return metrics;
+}
+
+/**
+ * Records the metrics of a glyph that are known without FreeType,
+ * used for baked fonts.
+ */
+void metrics_set_glyph(font_T* font, uint32_t codepoint, glyph_metrics_T metrics)
+{
+    pthread_mutex_lock(&font->metrics->lock);
+    metrics_insert(font->metrics, codepoint + 1, metrics);
+    pthread_mutex_unlock(&font->metrics->lock);
+}
+
+static text_metrics_T measure_range(font_T* font, const char* text, size_t length, float scale)
+{
+    text_metrics_T result;
+    memset(&result, 0, sizeof(struct TEXT_METRICS_STRUCT));
+    result.length = length;
+
+    int advance = 0;
+
+    const char* end = text + length;
+
+    while (text < end)
+    {
+        glyph_metrics_T metrics = metrics_get_glyph(font, utf8_decode(&text));
+
+        if (metrics.bearing_top * scale > result.ascent)
+            result.ascent = metrics.bearing_top * scale;
+
+        if ((metrics.height - metrics.bearing_top) * scale > result.descent)
+            result.descent = (metrics.height - metrics.bearing_top) * scale;
+
+        advance += metrics.advance >> 6;
+    }
+
+    result.width = advance * scale;
+
+    return result;
+}
+
+/**
+ * Measures a string as a single line, the same way text objects lay it out.
+ */
+text_metrics_T measure_string(font_T* font, const char* text, float scale)
+{
+    return measure_range(font, text, strlen(text), scale);
+}
+
+/**
+ * Measures every '\n' separated line of a string, writing at most max_lines results.
+ * Returns the amount of lines in the text.
+ */
+size_t measure_lines(font_T* font, const char* text, float scale, text_metrics_T* lines, size_t max_lines)
+{
+    size_t count = 0;
+    const char* start = text;
+
+    while (1)
+    {
+        const char* end = strchr(start, '\n');
+        size_t length = end ? (size_t)(end - start) : strlen(start);
+
+        if (count < max_lines)
+            lines[count] = measure_range(font, start, length, scale);
+
+        count += 1;
+
+        if (end == (void*)0)
+            break;
+
+        start = end + 1;
+    }
+
+    return count;
+}
+
+/**
+ * Baseline to baseline distance of the font.
+ */
+float metrics_get_line_height(font_T* font, float scale)
+{
+    return font->line_height * scale;
+}
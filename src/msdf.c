@@ -0,0 +1,801 @@
+#include "include/msdf.h"
+#include "include/sdf.h"
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+
+#define MSDF_CUBIC_SEARCH_STARTS 4
+#define MSDF_CUBIC_SEARCH_STEPS 4
+#define MSDF_CLASH_THRESHOLD 1.001    // Pixels, channels of neighbours further apart than this clash
+
+static msdf_point_T msdf_point(double x, double y)
+{
+    msdf_point_T point;
+    point.x = x;
+    point.y = y;
+
+    return point;
+}
+
+static msdf_point_T msdf_sub(msdf_point_T a, msdf_point_T b)
+{
+    return msdf_point(a.x - b.x, a.y - b.y);
+}
+
+static msdf_point_T msdf_add(msdf_point_T a, msdf_point_T b)
+{
+    return msdf_point(a.x + b.x, a.y + b.y);
+}
+
+static msdf_point_T msdf_scale(msdf_point_T a, double s)
+{
+    return msdf_point(a.x * s, a.y * s);
+}
+
+static msdf_point_T msdf_mix(msdf_point_T a, msdf_point_T b, double t)
+{
+    return msdf_point(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
+}
+
+static double msdf_dot(msdf_point_T a, msdf_point_T b)
+{
+    return a.x * b.x + a.y * b.y;
+}
+
+static double msdf_cross(msdf_point_T a, msdf_point_T b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+static double msdf_length(msdf_point_T a)
+{
+    return sqrt(a.x * a.x + a.y * a.y);
+}
+
+static msdf_point_T msdf_normalize(msdf_point_T a)
+{
+    double length = msdf_length(a);
+
+    if (length == 0)
+        return msdf_point(0, 1);
+
+    return msdf_scale(a, 1 / length);
+}
+
+static int msdf_is_zero(msdf_point_T a)
+{
+    return a.x == 0 && a.y == 0;
+}
+
+static double msdf_sign(double value)
+{
+    return value > 0 ? 1 : -1;
+}
+
+/**
+ * Tangent of an edge at t, falling back to a chord where control points coincide.
+ */
+static msdf_point_T msdf_edge_direction(msdf_edge_T* edge, double t)
+{
+    const msdf_point_T* p = edge->p;
+
+    if (edge->degree == 1)
+        return msdf_sub(p[1], p[0]);
+
+    if (edge->degree == 2)
+    {
+        msdf_point_T tangent = msdf_mix(msdf_sub(p[1], p[0]), msdf_sub(p[2], p[1]), t);
+        return msdf_is_zero(tangent) ? msdf_sub(p[2], p[0]) : tangent;
+    }
+
+    msdf_point_T tangent = msdf_mix(
+        msdf_mix(msdf_sub(p[1], p[0]), msdf_sub(p[2], p[1]), t),
+        msdf_mix(msdf_sub(p[2], p[1]), msdf_sub(p[3], p[2]), t),
+        t
+    );
+
+    if (!msdf_is_zero(tangent))
+        return tangent;
+
+    return t < 0.5 ? msdf_sub(p[2], p[0]) : msdf_sub(p[3], p[1]);
+}
+
+/**
+ * De Casteljau subdivision of an edge at t into the part before and after it.
+ */
+static void msdf_edge_split(msdf_edge_T* edge, double t, msdf_edge_T* before, msdf_edge_T* after)
+{
+    int n = edge->degree;
+    msdf_point_T w[4];
+    memcpy(w, edge->p, sizeof(w));
+
+    *before = *edge;
+    *after = *edge;
+    before->p[0] = w[0];
+    after->p[n] = w[n];
+
+    for (int k = 1; k <= n; k++)
+    {
+        for (int i = 0; i <= n - k; i++)
+            w[i] = msdf_mix(w[i], w[i + 1], t);
+
+        before->p[k] = w[0];
+        after->p[n - k] = w[n - k];
+    }
+}
+
+static void msdf_edge_split_in_thirds(msdf_edge_T* edge, msdf_edge_T parts[3])
+{
+    msdf_edge_T rest;
+    msdf_edge_split(edge, 1.0 / 3.0, &parts[0], &rest);
+    msdf_edge_split(&rest, 0.5, &parts[1], &parts[2]);
+}
+
+static int msdf_solve_quadratic(double x[2], double a, double b, double c)
+{
+    if (a == 0 || fabs(b) > 1e12 * fabs(a))
+    {
+        if (b == 0)
+            return 0;
+
+        x[0] = -c / b;
+        return 1;
+    }
+
+    double discriminant = b * b - 4 * a * c;
+
+    if (discriminant > 0)
+    {
+        discriminant = sqrt(discriminant);
+        x[0] = (-b + discriminant) / (2 * a);
+        x[1] = (-b - discriminant) / (2 * a);
+        return 2;
+    }
+
+    if (discriminant == 0)
+    {
+        x[0] = -b / (2 * a);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Real roots of x^3 + a x^2 + b x + c.
+ */
+static int msdf_solve_cubic_normed(double x[3], double a, double b, double c)
+{
+    double a2 = a * a;
+    double q = (a2 - 3 * b) / 9;
+    double r = (a * (2 * a2 - 9 * b) + 27 * c) / 54;
+    double r2 = r * r;
+    double q3 = q * q * q;
+
+    a /= 3;
+
+    if (r2 < q3)
+    {
+        double t = r / sqrt(q3);
+
+        if (t < -1)
+            t = -1;
+
+        if (t > 1)
+            t = 1;
+
+        t = acos(t);
+        q = -2 * sqrt(q);
+        x[0] = q * cos(t / 3) - a;
+        x[1] = q * cos((t + 2 * M_PI) / 3) - a;
+        x[2] = q * cos((t - 2 * M_PI) / 3) - a;
+        return 3;
+    }
+
+    double u = (r < 0 ? 1 : -1) * pow(fabs(r) + sqrt(r2 - q3), 1.0 / 3.0);
+    double v = u == 0 ? 0 : q / u;
+    x[0] = (u + v) - a;
+
+    if (u == v || fabs(u - v) < 1e-12 * fabs(u + v))
+    {
+        x[1] = -0.5 * (u + v) - a;
+        return 2;
+    }
+
+    return 1;
+}
+
+static int msdf_solve_cubic(double x[3], double a, double b, double c, double d)
+{
+    // Past this ratio treating the curve as quadratic is the smaller numerical error
+    if (a != 0 && fabs(b / a) < 1e6)
+        return msdf_solve_cubic_normed(x, b / a, c / a, d / a);
+
+    return msdf_solve_quadratic(x, b, c, d);
+}
+
+/**
+ * Signed distance from a point to an edge, positive on the right of its direction.
+ * `param` receives where along the edge the nearest point is, outside of [0, 1]
+ * when an endpoint is nearest. `dot` receives how parallel the edge runs to the line
+ * towards the point there, breaking ties between edges sharing that endpoint.
+ */
+static double msdf_edge_distance(msdf_edge_T* edge, msdf_point_T origin, double* param, double* dot)
+{
+    const msdf_point_T* p = edge->p;
+    int n = edge->degree;
+
+    if (n == 1)
+    {
+        msdf_point_T aq = msdf_sub(origin, p[0]);
+        msdf_point_T ab = msdf_sub(p[1], p[0]);
+        *param = msdf_dot(aq, ab) / msdf_dot(ab, ab);
+
+        msdf_point_T eq = msdf_sub(*param > 0.5 ? p[1] : p[0], origin);
+        double endpoint_distance = msdf_length(eq);
+
+        if (*param > 0 && *param < 1)
+        {
+            double ortho_distance = msdf_cross(aq, ab) / msdf_length(ab);
+
+            if (fabs(ortho_distance) < endpoint_distance)
+            {
+                *dot = 0;
+                return ortho_distance;
+            }
+        }
+
+        *dot = fabs(msdf_dot(msdf_normalize(ab), msdf_normalize(eq)));
+        return msdf_sign(msdf_cross(aq, ab)) * endpoint_distance;
+    }
+
+    // Start with the endpoints, then look for a nearer point inside the curve
+    msdf_point_T qa = msdf_sub(p[0], origin);
+    msdf_point_T direction = msdf_edge_direction(edge, 0);
+    double min_distance = msdf_sign(msdf_cross(direction, qa)) * msdf_length(qa);
+    *param = -msdf_dot(qa, direction) / msdf_dot(direction, direction);
+
+    msdf_point_T qb = msdf_sub(p[n], origin);
+    direction = msdf_edge_direction(edge, 1);
+
+    if (msdf_length(qb) < fabs(min_distance))
+    {
+        min_distance = msdf_sign(msdf_cross(direction, qb)) * msdf_length(qb);
+        *param = msdf_dot(msdf_sub(origin, p[n - 1]), direction) / msdf_dot(direction, direction);
+    }
+
+    msdf_point_T ab = msdf_sub(p[1], p[0]);
+    msdf_point_T br = msdf_sub(msdf_sub(p[2], p[1]), ab);
+
+    if (n == 2)
+    {
+        // The nearest point zeroes the derivative of the squared distance, a cubic in t
+        double t[3];
+        int solutions = msdf_solve_cubic(
+            t,
+            msdf_dot(br, br),
+            3 * msdf_dot(ab, br),
+            2 * msdf_dot(ab, ab) + msdf_dot(qa, br),
+            msdf_dot(qa, ab)
+        );
+
+        for (int i = 0; i < solutions; i++)
+        {
+            if (t[i] <= 0 || t[i] >= 1)
+                continue;
+
+            msdf_point_T qe = msdf_add(qa, msdf_add(msdf_scale(ab, 2 * t[i]), msdf_scale(br, t[i] * t[i])));
+            double distance = msdf_length(qe);
+
+            if (distance <= fabs(min_distance))
+            {
+                min_distance = msdf_sign(msdf_cross(msdf_add(ab, msdf_scale(br, t[i])), qe)) * distance;
+                *param = t[i];
+            }
+        }
+    }
+    else
+    {
+        // A quintic for cubics, Newton iterations from a few starting points instead
+        msdf_point_T as = msdf_sub(msdf_sub(msdf_sub(p[3], p[2]), msdf_sub(p[2], p[1])), br);
+
+        for (int i = 0; i <= MSDF_CUBIC_SEARCH_STARTS; i++)
+        {
+            double t = (double) i / MSDF_CUBIC_SEARCH_STARTS;
+            msdf_point_T qe = msdf_add(
+                msdf_add(qa, msdf_scale(ab, 3 * t)),
+                msdf_add(msdf_scale(br, 3 * t * t), msdf_scale(as, t * t * t))
+            );
+
+            for (int step = 0; step < MSDF_CUBIC_SEARCH_STEPS; step++)
+            {
+                msdf_point_T d1 = msdf_add(
+                    msdf_add(msdf_scale(ab, 3), msdf_scale(br, 6 * t)),
+                    msdf_scale(as, 3 * t * t)
+                );
+                msdf_point_T d2 = msdf_add(msdf_scale(br, 6), msdf_scale(as, 6 * t));
+
+                t -= msdf_dot(qe, d1) / (msdf_dot(d1, d1) + msdf_dot(qe, d2));
+
+                if (t <= 0 || t >= 1)
+                    break;
+
+                qe = msdf_add(
+                    msdf_add(qa, msdf_scale(ab, 3 * t)),
+                    msdf_add(msdf_scale(br, 3 * t * t), msdf_scale(as, t * t * t))
+                );
+                double distance = msdf_length(qe);
+
+                if (distance < fabs(min_distance))
+                {
+                    min_distance = msdf_sign(msdf_cross(d1, qe)) * distance;
+                    *param = t;
+                }
+            }
+        }
+    }
+
+    if (*param >= 0 && *param <= 1)
+        *dot = 0;
+    else if (*param < 0.5)
+        *dot = fabs(msdf_dot(msdf_normalize(msdf_edge_direction(edge, 0)), msdf_normalize(qa)));
+    else
+        *dot = fabs(msdf_dot(msdf_normalize(msdf_edge_direction(edge, 1)), msdf_normalize(qb)));
+
+    return min_distance;
+}
+
+/**
+ * Past an endpoint the distance to the edge's tangent line is used instead,
+ * which keeps the channels straight through corners.
+ */
+static double msdf_pseudo_distance(msdf_edge_T* edge, double distance, msdf_point_T origin, double param)
+{
+    if (param < 0)
+    {
+        msdf_point_T direction = msdf_normalize(msdf_edge_direction(edge, 0));
+        msdf_point_T aq = msdf_sub(origin, edge->p[0]);
+
+        if (msdf_dot(aq, direction) < 0)
+        {
+            double pseudo_distance = msdf_cross(aq, direction);
+
+            if (fabs(pseudo_distance) <= fabs(distance))
+                return pseudo_distance;
+        }
+    }
+    else if (param > 1)
+    {
+        msdf_point_T direction = msdf_normalize(msdf_edge_direction(edge, 1));
+        msdf_point_T bq = msdf_sub(origin, edge->p[edge->degree]);
+
+        if (msdf_dot(bq, direction) > 0)
+        {
+            double pseudo_distance = msdf_cross(bq, direction);
+
+            if (fabs(pseudo_distance) <= fabs(distance))
+                return pseudo_distance;
+        }
+    }
+
+    return distance;
+}
+
+/**
+ * Picks the next color of a contour, never the `banned` one.
+ * Deterministic for a seed, which is consumed as it goes.
+ */
+static void msdf_switch_color(int* color, unsigned long* seed, int banned)
+{
+    static const int start[3] = { MSDF_GREEN | MSDF_BLUE, MSDF_RED | MSDF_BLUE, MSDF_RED | MSDF_GREEN };
+    int combined = *color & banned;
+
+    if (combined == MSDF_RED || combined == MSDF_GREEN || combined == MSDF_BLUE)
+    {
+        *color = combined ^ MSDF_WHITE;
+        return;
+    }
+
+    if (*color == 0 || *color == MSDF_WHITE)
+    {
+        *color = start[*seed % 3];
+        *seed /= 3;
+        return;
+    }
+
+    int shifted = *color << (1 + (*seed & 1));
+    *color = (shifted | shifted >> 3) & MSDF_WHITE;
+    *seed >>= 1;
+}
+
+static int msdf_is_corner(msdf_point_T a, msdf_point_T b)
+{
+    return msdf_dot(a, b) <= 0 || fabs(msdf_cross(a, b)) > sin(MSDF_CORNER_ANGLE);
+}
+
+static void msdf_shape_push(msdf_shape_T* shape, msdf_edge_T* edge)
+{
+    if (shape->edges_size == shape->edges_capacity)
+    {
+        shape->edges_capacity = shape->edges_capacity ? shape->edges_capacity * 2 : 32;
+        shape->edges = realloc(shape->edges, sizeof(struct MSDF_EDGE_STRUCT) * shape->edges_capacity);
+    }
+
+    msdf_edge_T* added = &shape->edges[shape->edges_size++];
+    *added = *edge;
+    added->min = edge->p[0];
+    added->max = edge->p[0];
+
+    for (int i = 1; i <= edge->degree; i++)
+    {
+        added->min.x = fmin(added->min.x, edge->p[i].x);
+        added->min.y = fmin(added->min.y, edge->p[i].y);
+        added->max.x = fmax(added->max.x, edge->p[i].x);
+        added->max.y = fmax(added->max.y, edge->p[i].y);
+    }
+}
+
+/**
+ * Colors the edges of the last contour so every corner is shared by two edges
+ * with only one channel in common, the channels then keep the corner sharp.
+ * Smooth contours are white, a contour with a single corner is split into three colors.
+ */
+static void msdf_shape_color_contour(msdf_shape_T* shape)
+{
+    if (shape->contours_size == 0)
+        return;
+
+    size_t start = shape->contours[shape->contours_size - 1];
+    int m = shape->edges_size - start;
+    msdf_edge_T* edges = &shape->edges[start];
+    unsigned long seed = 0;
+
+    if (m == 0)
+        return;
+
+    int* corners = malloc(sizeof(int) * m);
+    int corners_size = 0;
+    msdf_point_T previous = msdf_edge_direction(&edges[m - 1], 1);
+
+    for (int i = 0; i < m; i++)
+    {
+        if (msdf_is_corner(msdf_normalize(previous), msdf_normalize(msdf_edge_direction(&edges[i], 0))))
+            corners[corners_size++] = i;
+
+        previous = msdf_edge_direction(&edges[i], 1);
+    }
+
+    if (corners_size == 0)
+    {
+        for (int i = 0; i < m; i++)
+            edges[i].color = MSDF_WHITE;
+    }
+    else if (corners_size == 1)
+    {
+        int colors[3] = { MSDF_WHITE, MSDF_WHITE, MSDF_WHITE };
+        msdf_switch_color(&colors[0], &seed, 0);
+        colors[2] = colors[0];
+        msdf_switch_color(&colors[2], &seed, 0);
+
+        int corner = corners[0];
+
+        if (m >= 3)
+        {
+            // Thirds of the contour going around from the corner
+            for (int i = 0; i < m; i++)
+                edges[(corner + i) % m].color = colors[1 + (int)(3 + 2.875 * i / (m - 1) - 1.4375 + 0.5) - 3];
+        }
+        else
+        {
+            // Fewer edges than colors, split them
+            msdf_edge_T parts[6];
+            msdf_edge_T first = edges[0];
+            msdf_edge_T second = edges[m - 1];
+
+            msdf_edge_split_in_thirds(&first, &parts[3 * corner]);
+
+            if (m == 2)
+                msdf_edge_split_in_thirds(&second, &parts[3 - 3 * corner]);
+
+            shape->edges_size = start;
+
+            for (int i = 0; i < m * 3; i++)
+            {
+                parts[i].color = m == 2 ? colors[i / 2] : colors[i];
+                msdf_shape_push(shape, &parts[i]);
+            }
+        }
+    }
+    else
+    {
+        int color = MSDF_WHITE;
+        msdf_switch_color(&color, &seed, 0);
+        int initial = color;
+        int spline = 0;
+
+        for (int i = 0; i < m; i++)
+        {
+            int index = (corners[0] + i) % m;
+
+            if (spline + 1 < corners_size && corners[spline + 1] == index)
+            {
+                spline += 1;
+
+                // The last spline meets the first one at a corner as well
+                msdf_switch_color(&color, &seed, spline == corners_size - 1 ? initial : 0);
+            }
+
+            edges[index].color = color;
+        }
+    }
+
+    free(corners);
+}
+
+static void msdf_shape_add(msdf_shape_T* shape, int degree, const FT_Vector** points)
+{
+    msdf_edge_T edge;
+    memset(&edge, 0, sizeof(struct MSDF_EDGE_STRUCT));
+    edge.degree = degree;
+    edge.p[0] = shape->position;
+
+    int degenerate = 1;
+
+    for (int i = 1; i <= degree; i++)
+    {
+        // 26.6 fixed point to pixels
+        edge.p[i] = msdf_point(points[i - 1]->x / 64.0, points[i - 1]->y / 64.0);
+        degenerate = degenerate && edge.p[i].x == edge.p[0].x && edge.p[i].y == edge.p[0].y;
+    }
+
+    shape->position = edge.p[degree];
+
+    // Zero length edges have no direction to measure against
+    if (!degenerate)
+        msdf_shape_push(shape, &edge);
+}
+
+static int msdf_move_to(const FT_Vector* to, void* user)
+{
+    msdf_shape_T* shape = user;
+    msdf_shape_color_contour(shape);
+
+    if (shape->contours_size == shape->contours_capacity)
+    {
+        shape->contours_capacity = shape->contours_capacity ? shape->contours_capacity * 2 : 8;
+        shape->contours = realloc(shape->contours, sizeof(size_t) * shape->contours_capacity);
+    }
+
+    shape->contours[shape->contours_size++] = shape->edges_size;
+    shape->position = msdf_point(to->x / 64.0, to->y / 64.0);
+
+    return 0;
+}
+
+static int msdf_line_to(const FT_Vector* to, void* user)
+{
+    const FT_Vector* points[1] = { to };
+    msdf_shape_add(user, 1, points);
+
+    return 0;
+}
+
+static int msdf_conic_to(const FT_Vector* control, const FT_Vector* to, void* user)
+{
+    const FT_Vector* points[2] = { control, to };
+    msdf_shape_add(user, 2, points);
+
+    return 0;
+}
+
+static int msdf_cubic_to(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
+{
+    const FT_Vector* points[3] = { control1, control2, to };
+    msdf_shape_add(user, 3, points);
+
+    return 0;
+}
+
+/**
+ * Distance of a point to the nearest edge of every channel.
+ */
+static void msdf_shape_distance(msdf_shape_T* shape, msdf_point_T origin, double distances[3])
+{
+    double min_distance[3] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+    double min_dot[3] = { 1, 1, 1 };
+    double near_param[3] = { 0, 0, 0 };
+    msdf_edge_T* near[3] = { (void*)0, (void*)0, (void*)0 };
+
+    for (size_t i = 0; i < shape->edges_size; i++)
+    {
+        msdf_edge_T* edge = &shape->edges[i];
+
+        // Edges whose box is further away than every channel's nearest edge cannot win
+        double dx = fmax(fmax(edge->min.x - origin.x, origin.x - edge->max.x), 0);
+        double dy = fmax(fmax(edge->min.y - origin.y, origin.y - edge->max.y), 0);
+        double bound = sqrt(dx * dx + dy * dy);
+        int closer = 0;
+
+        for (int c = 0; c < 3; c++)
+            closer = closer || ((edge->color & (1 << c)) && bound <= fabs(min_distance[c]));
+
+        if (!closer)
+            continue;
+
+        double param;
+        double dot;
+        double distance = msdf_edge_distance(edge, origin, &param, &dot);
+
+        for (int c = 0; c < 3; c++)
+        {
+            if (!(edge->color & (1 << c)))
+                continue;
+
+            if (fabs(distance) < fabs(min_distance[c])
+                || (fabs(distance) == fabs(min_distance[c]) && dot < min_dot[c]))
+            {
+                min_distance[c] = distance;
+                min_dot[c] = dot;
+                near_param[c] = param;
+                near[c] = edge;
+            }
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        distances[c] = near[c] != (void*)0
+            ? msdf_pseudo_distance(near[c], min_distance[c], origin, near_param[c])
+            : min_distance[c];
+    }
+}
+
+static float msdf_median(float a, float b, float c)
+{
+    return fmaxf(fminf(a, b), fminf(fmaxf(a, b), c));
+}
+
+/**
+ * Whether the channels of neighbouring texels a and b disagree so much
+ * that interpolating between them would create an artifact in a.
+ */
+static int msdf_clash(const float* a, const float* b, float threshold)
+{
+    float a0 = a[0], a1 = a[1], a2 = a[2];
+    float b0 = b[0], b1 = b[1], b2 = b[2];
+    float swap;
+
+    // Order the channels from the largest difference to the smallest
+    if (fabsf(b0 - a0) < fabsf(b1 - a1))
+    {
+        swap = a0, a0 = a1, a1 = swap;
+        swap = b0, b0 = b1, b1 = swap;
+    }
+
+    if (fabsf(b1 - a1) < fabsf(b2 - a2))
+    {
+        swap = a1, a1 = a2, a2 = swap;
+        swap = b1, b1 = b2, b2 = swap;
+
+        if (fabsf(b0 - a0) < fabsf(b1 - a1))
+        {
+            swap = a0, a0 = a1, a1 = swap;
+            swap = b0, b0 = b1, b1 = swap;
+        }
+    }
+
+    // Only the texel further from the edge is flagged, equalized neighbours are ignored
+    return fabsf(b1 - a1) >= threshold
+        && !(b0 == b1 && b0 == b2)
+        && fabsf(a2 - SDF_EDGE) >= fabsf(b2 - SDF_EDGE);
+}
+
+/**
+ * Collapses texels whose channels clash with a neighbour to their median,
+ * trading the sharp corner there for a clean edge.
+ */
+static void msdf_correct_clashes(float* field, int width, int height, float threshold)
+{
+    size_t size = (size_t) width * height;
+    unsigned char* clashes = calloc(size, 1);
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const float* texel = &field[((size_t) y * width + x) * 3];
+
+            clashes[(size_t) y * width + x] =
+                (x > 0 && msdf_clash(texel, texel - 3, threshold))
+                || (x < width - 1 && msdf_clash(texel, texel + 3, threshold))
+                || (y > 0 && msdf_clash(texel, texel - (size_t) width * 3, threshold))
+                || (y < height - 1 && msdf_clash(texel, texel + (size_t) width * 3, threshold));
+        }
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        if (!clashes[i])
+            continue;
+
+        float* texel = &field[i * 3];
+        float median = msdf_median(texel[0], texel[1], texel[2]);
+        texel[0] = median;
+        texel[1] = median;
+        texel[2] = median;
+    }
+
+    free(clashes);
+}
+
+/**
+ * Generates a multi-channel signed distance field of an outline in 26.6 pixels,
+ * with `spread` extra texels on every side of the width by rows box whose
+ * top left corner is at (left, top). Texels are three bytes, RGB.
+ * The median of the channels encodes the distance the same way sdf_generate does,
+ * while the channels on their own keep corners sharp at any magnification.
+ * Only touches its arguments, safe to call from any thread.
+ */
+unsigned char* msdf_generate(FT_Outline* outline, int left, int top, int width, int rows, int spread)
+{
+    msdf_shape_T shape;
+    memset(&shape, 0, sizeof(struct MSDF_SHAPE_STRUCT));
+
+    FT_Outline_Funcs funcs;
+    funcs.move_to = msdf_move_to;
+    funcs.line_to = msdf_line_to;
+    funcs.conic_to = msdf_conic_to;
+    funcs.cubic_to = msdf_cubic_to;
+    funcs.shift = 0;
+    funcs.delta = 0;
+
+    FT_Outline_Decompose(outline, &funcs, &shape);
+    msdf_shape_color_contour(&shape);
+
+    // Distances are positive on the right of edges, where TrueType fills
+    double fill = FT_Outline_Get_Orientation(outline) == FT_ORIENTATION_POSTSCRIPT ? -1 : 1;
+
+    int field_width = width + spread * 2;
+    int field_height = rows + spread * 2;
+    size_t size = (size_t) field_width * field_height;
+    float* field = malloc(sizeof(float) * size * 3);
+
+    for (int y = 0; y < field_height; y++)
+    {
+        for (int x = 0; x < field_width; x++)
+        {
+            // Texel centers, rows go down while the outline goes up
+            msdf_point_T origin = msdf_point(left - spread + x + 0.5, top + spread - y - 0.5);
+            double distances[3];
+            msdf_shape_distance(&shape, origin, distances);
+
+            for (int c = 0; c < 3; c++)
+                field[((size_t) y * field_width + x) * 3 + c] = SDF_EDGE + fill * distances[c] * SDF_EDGE / spread;
+        }
+    }
+
+    msdf_correct_clashes(field, field_width, field_height, MSDF_CLASH_THRESHOLD * SDF_EDGE / spread);
+
+    unsigned char* pixels = malloc(size * 3);
+
+    for (size_t i = 0; i < size * 3; i++)
+    {
+        float value = field[i] + 0.5f;
+
+        if (value < 0)
+            value = 0;
+
+        if (value > 255)
+            value = 255;
+
+        pixels[i] = (unsigned char) value;
+    }
+
+    free(field);
+    free(shape.edges);
+    free(shape.contours);
+
+    return pixels;
+}
@@ -0,0 +1,336 @@
+#include "include/raster_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+
+static raster_worker_T workers[RASTER_POOL_MAX_WORKERS];
+static int workers_size = 0;
+
+/**
+ * Submitted jobs, taken by the workers in order.
+ */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static raster_job_T* queue_head = (void*)0;
+static raster_job_T* queue_tail = (void*)0;
+static int stopping = 0;
+
+/**
+ * Finished jobs, a lock free stack pushed by every worker
+ * and emptied in one exchange by the GL thread.
+ */
+static _Atomic(raster_job_T*) done = (void*)0;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * Returns the worker's own face for a shared face at the given size,
+ * opening it on the shared font file mapping the first time.
+ */
+static FT_Face raster_worker_get_face(raster_worker_T* worker, font_T* font)
+{
+    raster_worker_face_T* entry = (void*)0;
+
+    for (size_t i = 0; i < worker->faces_size; i++)
+    {
+        if (worker->faces[i].face == font->face)
+        {
+            entry = &worker->faces[i];
+            break;
+        }
+    }
+
+    if (entry == (void*)0)
+    {
+        FT_Face ft_face;
+        font_file_T* file = font->face->file;
+
+        if (FT_New_Memory_Face(worker->library, file->data, file->size, font->face->index, &ft_face))
+        {
+            perror("ERROR::RASTER_POOL: Failed to load font");
+            return (void*)0;
+        }
+
+        worker->faces_size += 1;
+        worker->faces = realloc(worker->faces, sizeof(struct RASTER_WORKER_FACE_STRUCT) * worker->faces_size);
+
+        entry = &worker->faces[worker->faces_size - 1];
+        entry->face = font->face;
+        entry->ft_face = ft_face;
+        entry->pixel_size = 0;
+    }
+
+    if (entry->pixel_size != font->pixel_size)
+    {
+        FT_Set_Pixel_Sizes(entry->ft_face, 0, font->pixel_size);
+        entry->pixel_size = font->pixel_size;
+    }
+
+    return entry->ft_face;
+}
+
+static void raster_worker_render(raster_worker_T* worker, raster_job_T* job)
+{
+    memset(&job->bitmap, 0, sizeof(struct GLYPH_BITMAP_STRUCT));
+
+    FT_Face face = raster_worker_get_face(worker, job->font);
+
+    if (face == (void*)0)
+        return;
+
+    if (FT_Load_Char(face, job->codepoint, character_get_load_flags(job->font)))
+    {
+        perror("ERROR::RASTER_POOL: Failed to load Glyph");
+        return;
+    }
+
+    glyph_bitmap_T* bitmap = &job->bitmap;
+    unsigned char* pixels = character_convert(job->font, face->glyph, bitmap);
+
+    if (pixels == (void*)0)
+    {
+        // The slot is reused by the next load, keep a tightly packed copy
+        pixels = malloc(bitmap->width * bitmap->rows);
+
+        for (int y = 0; y < bitmap->rows; y++)
+            memcpy(&pixels[y * bitmap->width], &bitmap->pixels[y * bitmap->pitch], bitmap->width);
+
+        bitmap->pitch = bitmap->width;
+    }
+
+    bitmap->pixels = pixels;
+}
+
+static void* raster_worker_main(void* argument)
+{
+    raster_worker_T* worker = argument;
+
+    while (1)
+    {
+        pthread_mutex_lock(&queue_lock);
+
+        while (queue_head == (void*)0 && !stopping)
+            pthread_cond_wait(&queue_cond, &queue_lock);
+
+        if (stopping)
+        {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+
+        raster_job_T* job = queue_head;
+        queue_head = job->next;
+
+        if (queue_head == (void*)0)
+            queue_tail = (void*)0;
+
+        pthread_mutex_unlock(&queue_lock);
+
+        pthread_mutex_lock(&worker->lock);
+        raster_worker_render(worker, job);
+        pthread_mutex_unlock(&worker->lock);
+
+        raster_job_T* head = atomic_load_explicit(&done, memory_order_relaxed);
+        do
+        {
+            job->next = head;
+        }
+        while (!atomic_compare_exchange_weak_explicit(&done, &head, job, memory_order_release, memory_order_relaxed));
+
+        // Only wakes the GL thread when it blocks in raster_pool_collect
+        pthread_mutex_lock(&queue_lock);
+        pthread_cond_signal(&done_cond);
+        pthread_mutex_unlock(&queue_lock);
+    }
+
+    return (void*)0;
+}
+
+/**
+ * Starts the worker threads, one per core besides the GL thread when `count` is 0 or less.
+ */
+void raster_pool_start(int count)
+{
+    if (workers_size > 0)
+        return;
+
+    if (count <= 0)
+        count = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+
+    if (count < 1)
+        count = 1;
+
+    if (count > RASTER_POOL_MAX_WORKERS)
+        count = RASTER_POOL_MAX_WORKERS;
+
+    stopping = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        raster_worker_T* worker = &workers[workers_size];
+        memset(worker, 0, sizeof(struct RASTER_WORKER_STRUCT));
+
+        if (FT_Init_FreeType(&worker->library))
+        {
+            perror("ERROR::RASTER_POOL: Could not init FreeType Library");
+            break;
+        }
+
+        pthread_mutex_init(&worker->lock, (void*)0);
+
+        if (pthread_create(&worker->thread, (void*)0, raster_worker_main, worker))
+        {
+            perror("ERROR::RASTER_POOL: Failed to create worker thread");
+            pthread_mutex_destroy(&worker->lock);
+            FT_Done_FreeType(worker->library);
+            break;
+        }
+
+        workers_size += 1;
+    }
+}
+
+int raster_pool_running()
+{
+    return workers_size > 0;
+}
+
+/**
+ * Queues a glyph for rasterization, the font is retained until the job is released.
+ */
+void raster_pool_submit(font_T* font, uint32_t codepoint)
+{
+    raster_job_T* job = calloc(1, sizeof(struct RASTER_JOB_STRUCT));
+    job->font = font_retain(font);
+    job->codepoint = codepoint;
+
+    pthread_mutex_lock(&queue_lock);
+
+    if (queue_tail == (void*)0)
+        queue_head = job;
+    else
+        queue_tail->next = job;
+
+    queue_tail = job;
+
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+/**
+ * Takes every finished job, linked through `next` in the order they finished.
+ * Blocks until at least one job is done when `wait` is set.
+ */
+raster_job_T* raster_pool_collect(int wait)
+{
+    if (wait && atomic_load_explicit(&done, memory_order_acquire) == (void*)0)
+    {
+        pthread_mutex_lock(&queue_lock);
+
+        while (atomic_load_explicit(&done, memory_order_acquire) == (void*)0)
+            pthread_cond_wait(&done_cond, &queue_lock);
+
+        pthread_mutex_unlock(&queue_lock);
+    }
+
+    raster_job_T* jobs = atomic_exchange_explicit(&done, (void*)0, memory_order_acquire);
+
+    // The stack holds the most recent job first
+    raster_job_T* ordered = (void*)0;
+    while (jobs != (void*)0)
+    {
+        raster_job_T* next = jobs->next;
+        jobs->next = ordered;
+        ordered = jobs;
+        jobs = next;
+    }
+
+    return ordered;
+}
+
+void raster_pool_release(raster_job_T* job)
+{
+    font_close(job->font);
+    free((void*) job->bitmap.pixels);
+    free(job);
+}
+
+/**
+ * Closes the faces workers opened for a shared face,
+ * called before the shared face and its file mapping go away.
+ */
+void raster_pool_forget_face(font_face_T* face)
+{
+    for (int i = 0; i < workers_size; i++)
+    {
+        raster_worker_T* worker = &workers[i];
+
+        pthread_mutex_lock(&worker->lock);
+
+        for (size_t j = 0; j < worker->faces_size;)
+        {
+            if (worker->faces[j].face != face)
+            {
+                j++;
+                continue;
+            }
+
+            FT_Done_Face(worker->faces[j].ft_face);
+            worker->faces[j] = worker->faces[worker->faces_size - 1];
+            worker->faces_size -= 1;
+        }
+
+        pthread_mutex_unlock(&worker->lock);
+    }
+}
+
+/**
+ * Stops the workers, jobs that were not collected yet are dropped.
+ * The glyph cache resets the entries waiting on them when they are next requested.
+ */
+void raster_pool_stop()
+{
+    if (workers_size == 0)
+        return;
+
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    for (int i = 0; i < workers_size; i++)
+        pthread_join(workers[i].thread, (void*)0);
+
+    raster_job_T* job = queue_head;
+    while (job != (void*)0)
+    {
+        raster_job_T* next = job->next;
+        raster_pool_release(job);
+        job = next;
+    }
+
+    queue_head = (void*)0;
+    queue_tail = (void*)0;
+
+    job = raster_pool_collect(0);
+    while (job != (void*)0)
+    {
+        raster_job_T* next = job->next;
+        raster_pool_release(job);
+        job = next;
+    }
+
+    for (int i = 0; i < workers_size; i++)
+    {
+        raster_worker_T* worker = &workers[i];
+
+        // Also closes every face of the worker
+        FT_Done_FreeType(worker->library);
+        free(worker->faces);
+        pthread_mutex_destroy(&worker->lock);
+    }
+
+    workers_size = 0;
+}
@@ -0,0 +1,167 @@
+#include "include/sdf.h"
+#include <stdlib.h>
+#include <math.h>
+
+
+#define SDF_INF 1e20f
+
+/**
+ * Scratch space of one transform, sized for the longest line of the grid.
+ */
+typedef struct SDF_SCRATCH_STRUCT
+{
+    float* f;         // Squared distances of the line before the transform
+    float* z;         // Boundaries between the parabolas of the lower envelope
+    int* v;           // Apex of every parabola of the lower envelope
+} sdf_scratch_T;
+
+/**
+ * Exact 1D squared Euclidean distance transform of one row or column in linear time,
+ * as the lower envelope of the parabolas rooted at every sample (Felzenszwalb and Huttenlocher).
+ * Samples at SDF_INF root no parabola, a line without any is left untouched.
+ */
+static void sdf_transform_line(float* grid, size_t offset, size_t stride, int length, sdf_scratch_T* scratch)
+{
+    float* f = scratch->f;
+    float* z = scratch->z;
+    int* v = scratch->v;
+    int k = -1;
+
+    for (int q = 0; q < length; q++)
+    {
+        f[q] = grid[offset + q * stride];
+
+        if (f[q] >= SDF_INF)
+            continue;
+
+        float s = -SDF_INF;
+
+        // Drop the parabolas the new one hides
+        while (k >= 0)
+        {
+            int r = v[k];
+            s = ((f[q] + (float) q * q) - (f[r] + (float) r * r)) / (2.0f * (q - r));
+
+            if (s > z[k])
+                break;
+
+            k--;
+        }
+
+        if (k < 0)
+            s = -SDF_INF;
+
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = SDF_INF;
+    }
+
+    if (k < 0)
+        return;
+
+    k = 0;
+
+    for (int q = 0; q < length; q++)
+    {
+        while (z[k + 1] < q)
+            k++;
+
+        int r = v[k];
+        grid[offset + q * stride] = (float)(q - r) * (q - r) + f[r];
+    }
+}
+
+/**
+ * Columns first and then rows, which is exact for the Euclidean metric.
+ */
+static void sdf_transform(float* grid, int width, int height, sdf_scratch_T* scratch)
+{
+    for (int x = 0; x < width; x++)
+        sdf_transform_line(grid, x, width, height, scratch);
+
+    for (int y = 0; y < height; y++)
+        sdf_transform_line(grid, (size_t) y * width, 1, width, scratch);
+}
+
+/**
+ * Turns an 8 bit coverage bitmap into a signed distance field
+ * with `spread` extra texels on every side, width + 2 * spread by rows + 2 * spread bytes.
+ * Texels on the outline encode SDF_EDGE, a distance of `spread` or more
+ * saturates to 255 inside and to 0 outside.
+ * Partially covered pixels place the outline inside of them, so the field keeps
+ * the subpixel precision of the antialiased bitmap.
+ * Only touches its arguments, safe to call from any thread.
+ */
+unsigned char* sdf_generate(const unsigned char* coverage, int width, int rows, int pitch, int spread)
+{
+    int field_width = width + spread * 2;
+    int field_height = rows + spread * 2;
+    size_t size = (size_t) field_width * field_height;
+    int longest = field_width > field_height ? field_width : field_height;
+
+    // Squared distances to the nearest texel inside of the outline and outside of it
+    float* outer = malloc(sizeof(float) * size);
+    float* inner = malloc(sizeof(float) * size);
+
+    sdf_scratch_T scratch;
+    scratch.f = malloc(sizeof(float) * longest);
+    scratch.z = malloc(sizeof(float) * (longest + 1));
+    scratch.v = malloc(sizeof(int) * longest);
+
+    // The border is empty
+    for (size_t i = 0; i < size; i++)
+    {
+        outer[i] = SDF_INF;
+        inner[i] = 0;
+    }
+
+    for (int y = 0; y < rows; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            float a = coverage[(size_t) y * pitch + x] / 255.0f;
+            size_t i = (size_t)(y + spread) * field_width + x + spread;
+
+            if (a >= 1.0f)
+            {
+                outer[i] = 0;
+                inner[i] = SDF_INF;
+            }
+            else if (a > 0.0f)
+            {
+                float d = 0.5f - a;
+                outer[i] = d > 0 ? d * d : 0;
+                inner[i] = d < 0 ? d * d : 0;
+            }
+        }
+    }
+
+    sdf_transform(outer, field_width, field_height, &scratch);
+    sdf_transform(inner, field_width, field_height, &scratch);
+
+    unsigned char* field = malloc(size);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        // Positive inside of the outline
+        float distance = sqrtf(inner[i]) - sqrtf(outer[i]);
+        float value = SDF_EDGE + distance * SDF_EDGE / spread + 0.5f;
+
+        if (value < 0)
+            value = 0;
+
+        if (value > 255)
+            value = 255;
+
+        field[i] = (unsigned char) value;
+    }
+
+    free(outer);
+    free(inner);
+    free(scratch.f);
+    free(scratch.z);
+    free(scratch.v);
+
+    return field;
+}
@@ -0,0 +1,165 @@
+#include "include/stream_buffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define STREAM_BUFFER_PERSISTENT_FLAGS (GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+
+static void stream_buffer_allocate(stream_buffer_T* stream)
+{
+    size_t total = stream->region_size * STREAM_BUFFER_REGIONS;
+
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(stream->target, stream->buffer);
+
+    // Persistently mapped storage is written directly without any map calls
+    if (GLEW_ARB_buffer_storage)
+    {
+        glBufferStorage(stream->target, total, (void*)0, STREAM_BUFFER_PERSISTENT_FLAGS);
+        stream->persistent = glMapBufferRange(stream->target, 0, total, STREAM_BUFFER_PERSISTENT_FLAGS);
+    }
+    else
+    {
+        glBufferData(stream->target, total, (void*)0, GL_STREAM_DRAW);
+        stream->persistent = (void*)0;
+    }
+
+    glBindBuffer(stream->target, 0);
+
+    stream->region = 0;
+    stream->offset = 0;
+}
+
+static void stream_buffer_release(stream_buffer_T* stream)
+{
+    for (int i = 0; i < STREAM_BUFFER_REGIONS; i++)
+    {
+        if (stream->fences[i])
+        {
+            glDeleteSync(stream->fences[i]);
+            stream->fences[i] = 0;
+        }
+    }
+
+    if (stream->persistent != (void*)0)
+    {
+        glBindBuffer(stream->target, stream->buffer);
+        glUnmapBuffer(stream->target);
+        glBindBuffer(stream->target, 0);
+        stream->persistent = (void*)0;
+    }
+
+    // Draws already issued keep the storage alive until they are done
+    glDeleteBuffers(1, &stream->buffer);
+    stream->buffer = 0;
+}
+
+/**
+ * Blocks until the GPU has finished reading the given region,
+ * which only happens when the CPU is STREAM_BUFFER_REGIONS frames ahead.
+ */
+static void stream_buffer_wait(stream_buffer_T* stream, unsigned int region)
+{
+    GLsync fence = stream->fences[region];
+
+    if (!fence)
+        return;
+
+    GLenum result;
+    do
+    {
+        result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    }
+    while (result == GL_TIMEOUT_EXPIRED);
+
+    if (result == GL_WAIT_FAILED)
+        perror("ERROR::STREAM_BUFFER: Failed to wait for fence");
+
+    glDeleteSync(fence);
+    stream->fences[region] = 0;
+}
+
+stream_buffer_T* init_stream_buffer(GLenum target, size_t region_size)
+{
+    stream_buffer_T* stream = calloc(1, sizeof(struct STREAM_BUFFER_STRUCT));
+    stream->target = target;
+    stream->region_size = region_size;
+
+    stream_buffer_allocate(stream);
+
+    return stream;
+}
+
+/**
+ * Returns a write pointer to `bytes` bytes in the current region and
+ * stores their offset from the start of the buffer in `offset`.
+ * The buffer object is replaced by a larger one when a frame outgrows its region,
+ * so callers must compare `stream->buffer` against what they have bound.
+ */
+void* stream_buffer_map(stream_buffer_T* stream, size_t bytes, size_t alignment, size_t* offset)
+{
+    size_t start = ((stream->offset + alignment - 1) / alignment) * alignment;
+
+    if (start + bytes > stream->region_size)
+    {
+        size_t region_size = stream->region_size * 2;
+
+        while (region_size < bytes)
+            region_size *= 2;
+
+        stream_buffer_release(stream);
+        stream->region_size = region_size;
+        stream_buffer_allocate(stream);
+
+        start = 0;
+    }
+
+    stream_buffer_wait(stream, stream->region);
+
+    *offset = stream->region * stream->region_size + start;
+    stream->offset = start + bytes;
+
+    if (stream->persistent != (void*)0)
+        return stream->persistent + *offset;
+
+    // The fence already guarantees the GPU is done with this range
+    glBindBuffer(stream->target, stream->buffer);
+    stream->mapped = 1;
+
+    return glMapBufferRange(
+        stream->target,
+        *offset,
+        bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+    );
+}
+
+void stream_buffer_unmap(stream_buffer_T* stream)
+{
+    if (!stream->mapped)
+        return;
+
+    glBindBuffer(stream->target, stream->buffer);
+    glUnmapBuffer(stream->target);
+    stream->mapped = 0;
+}
+
+/**
+ * Fences the region written this frame and moves on to the next one.
+ * Call once per frame after the last draw sourcing from the buffer.
+ */
+void stream_buffer_end_frame(stream_buffer_T* stream)
+{
+    if (stream->fences[stream->region])
+        glDeleteSync(stream->fences[stream->region]);
+
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->region = (stream->region + 1) % STREAM_BUFFER_REGIONS;
+    stream->offset = 0;
+}
+
+void stream_buffer_free(stream_buffer_T* stream)
+{
+    stream_buffer_release(stream);
+    free(stream);
+}
@@ -0,0 +1,167 @@
+#include "include/text_batch.h"
+#include "include/glyph_cache.h"
+#include "include/atlas.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+text_batch_T* init_text_batch(GLuint program)
+{
+    text_batch_T* batch = calloc(1, sizeof(struct TEXT_BATCH_STRUCT));
+    batch->layout = glyph_instance_get_layout(program);
+    batch->color = GLYPH_INSTANCE_RGBA(255, 255, 255, 255);
+    batch->stream = init_stream_buffer(GL_ARRAY_BUFFER, TEXT_BATCH_REGION_SIZE);
+
+    glGenVertexArrays(1, &batch->VAO);
+    glyph_instance_setup_vao(&batch->layout, batch->VAO);
+
+    return batch;
+}
+
+/**
+ * Starts collecting a new set of strings,
+ * instance memory from the previous frame is kept for reuse.
+ */
+void text_batch_begin(text_batch_T* batch)
+{
+    for (size_t i = 0; i < batch->pages_size; i++)
+        batch->pages[i].size = 0;
+}
+
+void text_batch_set_color(text_batch_T* batch, uint32_t color)
+{
+    batch->color = color;
+}
+
+static glyph_instance_T* text_batch_reserve(text_batch_T* batch, unsigned int page_index)
+{
+    if (page_index >= batch->pages_size)
+    {
+        batch->pages = realloc(batch->pages, sizeof(struct TEXT_BATCH_PAGE_STRUCT) * (page_index + 1));
+        memset(
+            &batch->pages[batch->pages_size],
+            0,
+            sizeof(struct TEXT_BATCH_PAGE_STRUCT) * (page_index + 1 - batch->pages_size)
+        );
+        batch->pages_size = page_index + 1;
+    }
+
+    text_batch_page_T* page = &batch->pages[page_index];
+
+    if (page->size == page->capacity)
+    {
+        page->capacity = page->capacity ? page->capacity * 2 : 64;
+        page->instances = realloc(page->instances, GLYPH_INSTANCE_STRIDE * page->capacity);
+    }
+
+    return &page->instances[page->size];
+}
+
+/**
+ * Adds one glyph with its pen position at (x, y) on the baseline.
+ * The phase offsets the glyph inside the wobble animation of the vertex shader.
+ */
+void text_batch_add_glyph(text_batch_T* batch, glyph_id_T glyph, float x, float y, float scale, float phase)
+{
+    unsigned int page = glyph_store_get()->page[glyph];
+    glyph_instance_T* instance = text_batch_reserve(batch, page);
+
+    if (glyph_instance_init(instance, glyph, x, y, scale, batch->color, phase))
+        batch->pages[page].size += 1;
+}
+
+/**
+ * Adds every glyph of a UTF-8 string starting at (x, y) on the baseline,
+ * each glyph gets its index in the string as phase.
+ * Returns the pen position after the last glyph.
+ */
+float text_batch_add_string(text_batch_T* batch, font_T* font, const char* text, float x, float y, float scale)
+{
+    glyph_run_fill(&batch->run, text, font);
+
+    for (size_t i = 0; i < batch->run.size; i++)
+    {
+        glyph_id_T glyph = batch->run.ids[i];
+
+        text_batch_add_glyph(batch, glyph, x, y, scale, i);
+
+        x += glyph_store_get()->advance[glyph] * scale;
+    }
+
+    return x;
+}
+
+/**
+ * Writes the instances of all pages into the stream buffer in one go
+ * and issues one draw per atlas page.
+ * Expects the text program to be in use.
+ */
+void text_batch_flush(text_batch_T* batch)
+{
+    size_t total = 0;
+
+    for (size_t i = 0; i < batch->pages_size; i++)
+        total += batch->pages[i].size;
+
+    if (total == 0)
+        return;
+
+    size_t offset;
+    glyph_instance_T* data = stream_buffer_map(
+        batch->stream,
+        GLYPH_INSTANCE_STRIDE * total,
+        GLYPH_INSTANCE_STRIDE,
+        &offset
+    );
+
+    size_t written = 0;
+    for (size_t i = 0; i < batch->pages_size; i++)
+    {
+        text_batch_page_T* page = &batch->pages[i];
+
+        memcpy(&data[written], page->instances, GLYPH_INSTANCE_STRIDE * page->size);
+        written += page->size;
+    }
+
+    stream_buffer_unmap(batch->stream);
+
+    // Glyphs added since the last flush become visible to the draws below
+    atlas_publish();
+
+    glBindVertexArray(batch->VAO);
+
+    for (size_t i = 0; i < batch->pages_size; i++)
+    {
+        text_batch_page_T* page = &batch->pages[i];
+
+        if (page->size == 0)
+            continue;
+
+        glyph_instance_draw(&batch->layout, batch->stream->buffer, offset, i, page->size);
+        offset += GLYPH_INSTANCE_STRIDE * page->size;
+    }
+
+    glBindVertexArray(0);
+}
+
+/**
+ * Marks the end of a frame for the streamed instances and the atlas pages,
+ * call after the last flush of the frame.
+ */
+void text_batch_end_frame(text_batch_T* batch)
+{
+    stream_buffer_end_frame(batch->stream);
+    atlas_end_frame();
+}
+
+void text_batch_free(text_batch_T* batch)
+{
+    for (size_t i = 0; i < batch->pages_size; i++)
+        free(batch->pages[i].instances);
+
+    free(batch->pages);
+    glyph_run_free(&batch->run);
+    stream_buffer_free(batch->stream);
+    glDeleteVertexArrays(1, &batch->VAO);
+    free(batch);
+}
@@ -0,0 +1,649 @@
+#include "include/text_object.h"
+#include "include/glyph_cache.h"
+#include "include/atlas.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+#define TEXT_RENDERER_INITIAL_CAPACITY 1024
+
+// Scratch space of text_object_layout, reused between layouts
+static unsigned int* layout_pages = (void*)0;
+static glyph_instance_T* layout_instances = (void*)0;
+static size_t layout_capacity = 0;
+static glyph_run_T layout_run;
+
+text_renderer_T* init_text_renderer(GLuint program)
+{
+    text_renderer_T* renderer = calloc(1, sizeof(struct TEXT_RENDERER_STRUCT));
+    renderer->layout = glyph_instance_get_layout(program);
+    renderer->VBO_capacity = TEXT_RENDERER_INITIAL_CAPACITY;
+
+    glGenVertexArrays(1, &renderer->VAO);
+    glyph_instance_setup_vao(&renderer->layout, renderer->VAO);
+
+    // Unused instances must read as empty, they are drawn over when runs are merged
+    void* zeros = calloc(renderer->VBO_capacity, GLYPH_INSTANCE_STRIDE);
+
+    glGenBuffers(1, &renderer->VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->VBO);
+    glBufferData(GL_ARRAY_BUFFER, GLYPH_INSTANCE_STRIDE * renderer->VBO_capacity, zeros, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    free(zeros);
+
+    return renderer;
+}
+
+text_object_T* init_text_object(text_renderer_T* renderer, font_T* font, const char* text, float x, float y, float scale)
+{
+    text_object_T* object = calloc(1, sizeof(struct TEXT_OBJECT_STRUCT));
+    object->font = font_retain(font);
+    object->text = strdup(text);
+    object->x = x;
+    object->y = y;
+    object->scale = scale;
+    object->color = GLYPH_INSTANCE_RGBA(255, 255, 255, 255);
+    object->layout_dirty = 1;
+    object->dirty = 1;
+
+    renderer->objects_size += 1;
+    renderer->objects = realloc(renderer->objects, sizeof(struct TEXT_OBJECT_STRUCT*) * renderer->objects_size);
+    renderer->objects[renderer->objects_size - 1] = object;
+
+    return object;
+}
+
+void text_object_set_text(text_object_T* object, const char* text)
+{
+    if (strcmp(object->text, text) == 0)
+        return;
+
+    free(object->text);
+    object->text = strdup(text);
+    object->layout_dirty = 1;
+    object->dirty = 1;
+}
+
+/**
+ * Moving an object shifts its cached glyphs, it is never laid out again.
+ */
+void text_object_set_position(text_object_T* object, float x, float y)
+{
+    if (x == object->x && y == object->y)
+        return;
+
+    if (!object->layout_dirty)
+    {
+        for (size_t i = 0; i < object->instances_size; i++)
+        {
+            object->instances[i].x += x - object->x;
+            object->instances[i].y += y - object->y;
+        }
+    }
+
+    object->x = x;
+    object->y = y;
+    object->dirty = 1;
+}
+
+void text_object_set_color(text_object_T* object, uint32_t color)
+{
+    if (color == object->color)
+        return;
+
+    if (!object->layout_dirty)
+    {
+        for (size_t i = 0; i < object->instances_size; i++)
+            object->instances[i].color = color;
+    }
+
+    object->color = color;
+    object->dirty = 1;
+}
+
+/**
+ * Places every glyph of the text and groups the instances by atlas page.
+ */
+static void text_object_layout(text_object_T* object)
+{
+    size_t length = strlen(object->text);
+
+    // The byte length bounds the amount of glyphs
+    if (length > layout_capacity)
+    {
+        layout_capacity = length * 2;
+        layout_pages = realloc(layout_pages, sizeof(unsigned int) * layout_capacity);
+        layout_instances = realloc(layout_instances, GLYPH_INSTANCE_STRIDE * layout_capacity);
+    }
+
+    size_t size = 0;
+    unsigned int pages_size = 0;
+    float x = object->x;
+
+    // Every cache miss happens here, the store columns stay put during the loop
+    glyph_run_fill(&layout_run, object->text, object->font);
+    glyph_store_T* store = glyph_store_get();
+    glyph_id_T placeholder = object->font->glyphs->placeholder;
+
+    object->placeholders = 0;
+    object->glyph_generation = glyph_cache_get_generation();
+    object->atlas_relocations = atlas_get_relocations();
+
+    for (size_t i = 0; i < layout_run.size; i++)
+    {
+        glyph_id_T glyph = layout_run.ids[i];
+        unsigned int page = store->page[glyph];
+
+        if (glyph == placeholder)
+            object->placeholders = 1;
+
+        if (glyph_instance_init(&layout_instances[size], glyph, x, object->y, object->scale, object->color, i))
+        {
+            layout_pages[size] = page;
+            size += 1;
+
+            if (page + 1 > pages_size)
+                pages_size = page + 1;
+        }
+
+        x += store->advance[glyph] * object->scale;
+    }
+
+    object->width = x - object->x;
+
+    object->glyphs = realloc(object->glyphs, sizeof(glyph_id_T) * layout_run.size);
+    memcpy(object->glyphs, layout_run.ids, sizeof(glyph_id_T) * layout_run.size);
+    object->glyphs_size = layout_run.size;
+
+    if (size > object->instances_capacity)
+    {
+        object->instances_capacity = size;
+        object->instances = realloc(object->instances, GLYPH_INSTANCE_STRIDE * size);
+    }
+
+    object->page_counts = realloc(object->page_counts, sizeof(size_t) * (pages_size + 1));
+    object->page_counts_size = pages_size;
+    memset(object->page_counts, 0, sizeof(size_t) * (pages_size + 1));
+
+    // Counting sort by page keeps each page a single contiguous run
+    for (size_t i = 0; i < size; i++)
+        object->page_counts[layout_pages[i]] += 1;
+
+    size_t starts[pages_size + 1];
+    size_t start = 0;
+    for (unsigned int page = 0; page < pages_size; page++)
+    {
+        starts[page] = start;
+        start += object->page_counts[page];
+    }
+
+    for (size_t i = 0; i < size; i++)
+        object->instances[starts[layout_pages[i]]++] = layout_instances[i];
+
+    object->instances_size = size;
+    object->layout_dirty = 0;
+}
+
+float text_object_get_width(text_object_T* object)
+{
+    if (object->layout_dirty)
+        text_object_layout(object);
+
+    return object->width;
+}
+
+/**
+ * Overwrites instances of the renderer buffer with empty ones,
+ * which draw as degenerate quads.
+ */
+static void text_renderer_clear_range(text_renderer_T* renderer, size_t offset, size_t size)
+{
+    if (size == 0)
+        return;
+
+    void* zeros = calloc(size, GLYPH_INSTANCE_STRIDE);
+
+    glBindBuffer(GL_ARRAY_BUFFER, renderer->VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, GLYPH_INSTANCE_STRIDE * offset, GLYPH_INSTANCE_STRIDE * size, zeros);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    free(zeros);
+}
+
+static void text_object_finish_upload(text_object_T* object)
+{
+    if (object->upload == (void*)0)
+        return;
+
+    upload_job_release(object->upload);
+    object->upload = (void*)0;
+}
+
+static void text_renderer_remove_range(text_renderer_T* renderer, size_t index)
+{
+    memmove(
+        &renderer->free_ranges[index],
+        &renderer->free_ranges[index + 1],
+        sizeof(struct TEXT_RANGE_STRUCT) * (renderer->free_ranges_size - index - 1)
+    );
+    renderer->free_ranges_size -= 1;
+}
+
+/**
+ * Gives a range of instances back, it is merged with the free ranges next to it.
+ * A range reaching the end of what was handed out moves that end back instead.
+ * Its old instances stay, the next owner overwrites all of them.
+ */
+static void text_renderer_release(text_renderer_T* renderer, size_t offset, size_t size)
+{
+    if (size == 0)
+        return;
+
+    size_t i = 0;
+    while (i < renderer->free_ranges_size && renderer->free_ranges[i].offset < offset)
+        i++;
+
+    text_range_T* ranges = renderer->free_ranges;
+    int joins_previous = i > 0 && ranges[i - 1].offset + ranges[i - 1].size == offset;
+    int joins_next = i < renderer->free_ranges_size && offset + size == ranges[i].offset;
+
+    if (joins_previous && joins_next)
+    {
+        ranges[i - 1].size += size + ranges[i].size;
+        text_renderer_remove_range(renderer, i);
+    }
+    else if (joins_previous)
+    {
+        ranges[i - 1].size += size;
+    }
+    else if (joins_next)
+    {
+        ranges[i].offset = offset;
+        ranges[i].size += size;
+    }
+    else
+    {
+        if (renderer->free_ranges_size == renderer->free_ranges_capacity)
+        {
+            renderer->free_ranges_capacity = renderer->free_ranges_capacity ? renderer->free_ranges_capacity * 2 : 16;
+            renderer->free_ranges = realloc(renderer->free_ranges, sizeof(struct TEXT_RANGE_STRUCT) * renderer->free_ranges_capacity);
+        }
+
+        memmove(
+            &renderer->free_ranges[i + 1],
+            &renderer->free_ranges[i],
+            sizeof(struct TEXT_RANGE_STRUCT) * (renderer->free_ranges_size - i)
+        );
+        renderer->free_ranges[i].offset = offset;
+        renderer->free_ranges[i].size = size;
+        renderer->free_ranges_size += 1;
+    }
+
+    text_range_T* last = &renderer->free_ranges[renderer->free_ranges_size - 1];
+
+    if (last->offset + last->size == renderer->VBO_size)
+    {
+        renderer->VBO_size = last->offset;
+        renderer->free_ranges_size -= 1;
+    }
+}
+
+/**
+ * Hands out `size` instances from the first released range they fit in,
+ * else at the end of the buffer, growing it when needed.
+ */
+static size_t text_renderer_allocate(text_renderer_T* renderer, size_t size)
+{
+    for (size_t i = 0; i < renderer->free_ranges_size; i++)
+    {
+        text_range_T* range = &renderer->free_ranges[i];
+
+        if (range->size < size)
+            continue;
+
+        size_t offset = range->offset;
+        range->offset += size;
+        range->size -= size;
+
+        if (range->size == 0)
+            text_renderer_remove_range(renderer, i);
+
+        return offset;
+    }
+
+    if (renderer->VBO_size + size > renderer->VBO_capacity)
+    {
+        // The copy below must see what the upload thread writes, growing is rare enough to wait
+        for (size_t i = 0; i < renderer->objects_size; i++)
+            text_object_finish_upload(renderer->objects[i]);
+
+        size_t capacity = renderer->VBO_capacity * 2;
+
+        while (renderer->VBO_size + size > capacity)
+            capacity *= 2;
+
+        GLuint VBO;
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+        glBufferData(GL_COPY_WRITE_BUFFER, GLYPH_INSTANCE_STRIDE * capacity, (void*)0, GL_DYNAMIC_DRAW);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, renderer->VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, GLYPH_INSTANCE_STRIDE * renderer->VBO_size);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        glDeleteBuffers(1, &renderer->VBO);
+        renderer->VBO = VBO;
+        renderer->VBO_capacity = capacity;
+
+        // The new tail must read as empty instances
+        text_renderer_clear_range(renderer, renderer->VBO_size, capacity - renderer->VBO_size);
+    }
+
+    size_t offset = renderer->VBO_size;
+    renderer->VBO_size += size;
+
+    return offset;
+}
+
+/**
+ * Instances copied for the upload thread, they follow in the same allocation.
+ */
+typedef struct TEXT_OBJECT_UPLOAD_STRUCT
+{
+    GLuint VBO;
+    size_t offset;            // Bytes
+    size_t size;              // Bytes
+} text_object_upload_T;
+
+static void text_object_upload_run(void* data)
+{
+    text_object_upload_T* upload = data;
+
+    glBindBuffer(GL_ARRAY_BUFFER, upload->VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, upload->offset, upload->size, upload + 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/**
+ * Writes the instances of an object into its range of the renderer buffer.
+ * Objects that were never drawn are written by the upload thread when it runs,
+ * so a large text appearing at once never holds up the frame.
+ * Returns the index of the object afterwards, outgrown objects move to a new range
+ * and to its place in the draw order.
+ */
+static size_t text_renderer_upload(text_renderer_T* renderer, size_t index)
+{
+    text_object_T* object = renderer->objects[index];
+
+    if (object->instances_size > object->capacity)
+    {
+        text_renderer_release(renderer, object->offset, object->capacity);
+
+        size_t capacity = TEXT_OBJECT_MIN_CAPACITY;
+        while (capacity < object->instances_size)
+            capacity *= 2;
+
+        object->offset = text_renderer_allocate(renderer, capacity);
+        object->capacity = capacity;
+
+        // A released range still holds the instances of its last owner
+        object->uploaded_size = capacity;
+
+        memmove(
+            &renderer->objects[index],
+            &renderer->objects[index + 1],
+            sizeof(struct TEXT_OBJECT_STRUCT*) * (renderer->objects_size - index - 1)
+        );
+
+        // Runs are merged across consecutive objects, the order must follow the offsets
+        index = 0;
+        while (index < renderer->objects_size - 1
+            && (renderer->objects[index]->capacity == 0 || renderer->objects[index]->offset < object->offset))
+            index++;
+
+        memmove(
+            &renderer->objects[index + 1],
+            &renderer->objects[index],
+            sizeof(struct TEXT_OBJECT_STRUCT*) * (renderer->objects_size - index - 1)
+        );
+        renderer->objects[index] = object;
+    }
+
+    if (!object->shown && object->instances_size > 0 && upload_thread_running())
+    {
+        // The rest of the range is written empty in the same job, never from this thread
+        size_t size = object->uploaded_size > object->instances_size ? object->uploaded_size : object->instances_size;
+        size_t bytes = GLYPH_INSTANCE_STRIDE * object->instances_size;
+        text_object_upload_T* upload = calloc(1, sizeof(struct TEXT_OBJECT_UPLOAD_STRUCT) + GLYPH_INSTANCE_STRIDE * size);
+        upload->VBO = renderer->VBO;
+        upload->offset = GLYPH_INSTANCE_STRIDE * object->offset;
+        upload->size = GLYPH_INSTANCE_STRIDE * size;
+        memcpy(upload + 1, object->instances, bytes);
+
+        object->upload = upload_thread_submit(text_object_upload_run, upload);
+        object->uploaded_size = object->instances_size;
+    }
+    else
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, renderer->VBO);
+        glBufferSubData(
+            GL_ARRAY_BUFFER,
+            GLYPH_INSTANCE_STRIDE * object->offset,
+            GLYPH_INSTANCE_STRIDE * object->instances_size,
+            object->instances
+        );
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    if (object->uploaded_size > object->instances_size)
+    {
+        text_renderer_clear_range(
+            renderer,
+            object->offset + object->instances_size,
+            object->uploaded_size - object->instances_size
+        );
+    }
+
+    object->uploaded_size = object->instances_size;
+    object->dirty = 0;
+
+    return index;
+}
+
+/**
+ * Whether a glyph moved off a page the object has instances on since it was laid out.
+ */
+static int text_object_relocated(text_object_T* object)
+{
+    for (unsigned int page = 0; page < object->page_counts_size; page++)
+    {
+        if (object->page_counts[page] > 0 && atlas_get_page(page)->relocated > object->atlas_relocations)
+            return 1;
+    }
+
+    return 0;
+}
+
+static void text_renderer_draw_run(text_renderer_T* renderer, unsigned int page, size_t start, size_t end)
+{
+    glyph_instance_draw(
+        &renderer->layout,
+        renderer->VBO,
+        GLYPH_INSTANCE_STRIDE * start,
+        page,
+        end - start
+    );
+}
+
+/**
+ * Lays out and uploads the objects that changed, then draws all of them.
+ * Runs of the same atlas page in objects whose ranges follow each other become a single draw,
+ * the unused instances at the end of a range are empty and draw nothing.
+ * Expects the text program to be in use.
+ */
+void text_renderer_draw(text_renderer_T* renderer)
+{
+    for (size_t i = 0; i < renderer->objects_size;)
+    {
+        text_object_T* object = renderer->objects[i];
+
+        // Nothing changes about an object while the upload thread writes its range
+        if (object->upload != (void*)0)
+        {
+            if (!upload_job_done(object->upload))
+            {
+                glyph_cache_touch(object->glyphs, object->glyphs_size);
+                i++;
+                continue;
+            }
+
+            text_object_finish_upload(object);
+        }
+
+        // Glyphs that were still being rasterized may have arrived
+        if (object->placeholders && object->glyph_generation != glyph_cache_get_generation())
+        {
+            object->layout_dirty = 1;
+            object->dirty = 1;
+        }
+
+        // Glyphs may have been moved off the pages of the layout by repacking
+        if (object->atlas_relocations != atlas_get_relocations())
+        {
+            if (text_object_relocated(object))
+            {
+                object->layout_dirty = 1;
+                object->dirty = 1;
+            }
+
+            object->atlas_relocations = atlas_get_relocations();
+        }
+
+        if (object->layout_dirty)
+            text_object_layout(object);
+        else
+            glyph_cache_touch(object->glyphs, object->glyphs_size);
+
+        if (!object->dirty)
+        {
+            i++;
+            continue;
+        }
+
+        // Moved behind index i, the next object now sits there and the moved one comes up again
+        if (text_renderer_upload(renderer, i) <= i)
+            i++;
+    }
+
+    // Glyphs rasterized by the layouts above become visible to the draws below
+    atlas_publish();
+
+    glBindVertexArray(renderer->VAO);
+
+    int pending = 0;
+    unsigned int pending_page = 0;
+    size_t pending_start = 0;
+    size_t pending_end = 0;
+    size_t previous_end = 0;
+
+    for (size_t i = 0; i < renderer->objects_size; i++)
+    {
+        text_object_T* object = renderer->objects[i];
+        size_t start = object->offset;
+
+        // Its range is still being written or a free range lies before it, a run must not reach across
+        if (object->upload != (void*)0 || (object->capacity > 0 && start != previous_end))
+        {
+            if (pending)
+                text_renderer_draw_run(renderer, pending_page, pending_start, pending_end);
+
+            pending = 0;
+        }
+
+        if (object->capacity > 0)
+            previous_end = start + object->capacity;
+
+        if (object->upload != (void*)0)
+            continue;
+
+        object->shown = 1;
+
+        for (unsigned int page = 0; page < object->page_counts_size; page++)
+        {
+            size_t count = object->page_counts[page];
+
+            if (count == 0)
+                continue;
+
+            if (pending && page == pending_page)
+            {
+                pending_end = start + count;
+            }
+            else
+            {
+                if (pending)
+                    text_renderer_draw_run(renderer, pending_page, pending_start, pending_end);
+
+                pending = 1;
+                pending_page = page;
+                pending_start = start;
+                pending_end = start + count;
+            }
+
+            start += count;
+        }
+    }
+
+    if (pending)
+        text_renderer_draw_run(renderer, pending_page, pending_start, pending_end);
+
+    glBindVertexArray(0);
+}
+
+static void text_object_destroy(text_object_T* object)
+{
+    text_object_finish_upload(object);
+    font_close(object->font);
+    free(object->text);
+    free(object->instances);
+    free(object->page_counts);
+    free(object->glyphs);
+    free(object);
+}
+
+void text_object_free(text_renderer_T* renderer, text_object_T* object)
+{
+    // The range must not be written once another object took it
+    text_object_finish_upload(object);
+    text_renderer_release(renderer, object->offset, object->capacity);
+
+    for (size_t i = 0; i < renderer->objects_size; i++)
+    {
+        if (renderer->objects[i] == object)
+        {
+            memmove(
+                &renderer->objects[i],
+                &renderer->objects[i + 1],
+                sizeof(struct TEXT_OBJECT_STRUCT*) * (renderer->objects_size - i - 1)
+            );
+            renderer->objects_size -= 1;
+            break;
+        }
+    }
+
+    text_object_destroy(object);
+}
+
+void text_renderer_free(text_renderer_T* renderer)
+{
+    for (size_t i = 0; i < renderer->objects_size; i++)
+        text_object_destroy(renderer->objects[i]);
+
+    free(renderer->objects);
+    free(renderer->free_ranges);
+    glDeleteBuffers(1, &renderer->VBO);
+    glDeleteVertexArrays(1, &renderer->VAO);
+    free(renderer);
+}
@@ -0,0 +1,226 @@
+#include "include/upload_thread.h"
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+static pthread_t thread;
+static int running = 0;
+static GLFWwindow* window = (void*)0;
+
+/**
+ * Submitted jobs, run by the upload thread in order.
+ */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static upload_job_T* queue_head = (void*)0;
+static upload_job_T* queue_tail = (void*)0;
+static int stopping = 0;
+
+static void* upload_thread_main(void* argument)
+{
+    glfwMakeContextCurrent(window);
+
+    while (1)
+    {
+        pthread_mutex_lock(&queue_lock);
+
+        while (queue_head == (void*)0 && !stopping)
+            pthread_cond_wait(&queue_cond, &queue_lock);
+
+        // Queued jobs still run when stopping, their owners wait for them
+        if (queue_head == (void*)0)
+        {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+
+        upload_job_T* job = queue_head;
+        queue_head = job->next;
+
+        if (queue_head == (void*)0)
+            queue_tail = (void*)0;
+
+        pthread_mutex_unlock(&queue_lock);
+
+        job->run(job->data);
+
+        // Flushed so the render context can see the fence at all
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        pthread_mutex_lock(&queue_lock);
+        job->fence = fence;
+        job->state = UPLOAD_JOB_SUBMITTED;
+        pthread_cond_broadcast(&done_cond);
+        pthread_mutex_unlock(&queue_lock);
+    }
+
+    glfwMakeContextCurrent((void*)0);
+
+    return (void*)0;
+}
+
+/**
+ * Starts the upload thread on `context`, a window the caller created sharing objects
+ * with the render context, usually invisible. GLFW only creates windows on the main thread.
+ * Returns 0 when the thread could not be started, uploads then stay on the render thread.
+ */
+int upload_thread_start(GLFWwindow* context)
+{
+    if (running)
+        return 1;
+
+    if (context == (void*)0)
+        return 0;
+
+    window = context;
+    stopping = 0;
+
+    if (pthread_create(&thread, (void*)0, upload_thread_main, (void*)0))
+    {
+        perror("ERROR::UPLOAD_THREAD: Failed to create upload thread");
+        window = (void*)0;
+        return 0;
+    }
+
+    running = 1;
+
+    return 1;
+}
+
+int upload_thread_running()
+{
+    return running;
+}
+
+/**
+ * Queues `run` to issue GL commands on the upload thread, `data` is passed to it
+ * and freed once the job is released.
+ * The objects it writes must not be used by the render thread before upload_job_done.
+ */
+upload_job_T* upload_thread_submit(void (*run)(void* data), void* data)
+{
+    upload_job_T* job = calloc(1, sizeof(struct UPLOAD_JOB_STRUCT));
+    job->run = run;
+    job->data = data;
+    job->state = UPLOAD_JOB_QUEUED;
+
+    pthread_mutex_lock(&queue_lock);
+
+    if (queue_tail == (void*)0)
+        queue_head = job;
+    else
+        queue_tail->next = job;
+
+    queue_tail = job;
+
+    pthread_cond_signal(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    return job;
+}
+
+static int upload_job_get_state(upload_job_T* job)
+{
+    pthread_mutex_lock(&queue_lock);
+    int state = job->state;
+    pthread_mutex_unlock(&queue_lock);
+
+    return state;
+}
+
+static void upload_job_finish(upload_job_T* job)
+{
+    glDeleteSync(job->fence);
+
+    pthread_mutex_lock(&queue_lock);
+    job->fence = 0;
+    job->state = UPLOAD_JOB_DONE;
+    pthread_mutex_unlock(&queue_lock);
+}
+
+/**
+ * Whether the GPU executed the commands of a job, never blocks.
+ * Call on the render thread, the objects it wrote are current there once this returns 1.
+ */
+int upload_job_done(upload_job_T* job)
+{
+    int state = upload_job_get_state(job);
+
+    if (state != UPLOAD_JOB_SUBMITTED)
+        return state == UPLOAD_JOB_DONE;
+
+    GLenum result = glClientWaitSync(job->fence, 0, 0);
+
+    if (result == GL_TIMEOUT_EXPIRED)
+        return 0;
+
+    if (result == GL_WAIT_FAILED)
+        perror("ERROR::UPLOAD_THREAD: Failed to poll fence");
+
+    upload_job_finish(job);
+
+    return 1;
+}
+
+/**
+ * Blocks until a job is done, only for objects about to be deleted or replaced.
+ */
+void upload_job_wait(upload_job_T* job)
+{
+    pthread_mutex_lock(&queue_lock);
+
+    while (job->state == UPLOAD_JOB_QUEUED)
+        pthread_cond_wait(&done_cond, &queue_lock);
+
+    int state = job->state;
+    pthread_mutex_unlock(&queue_lock);
+
+    if (state == UPLOAD_JOB_DONE)
+        return;
+
+    GLenum result;
+    do
+    {
+        result = glClientWaitSync(job->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    }
+    while (result == GL_TIMEOUT_EXPIRED);
+
+    if (result == GL_WAIT_FAILED)
+        perror("ERROR::UPLOAD_THREAD: Failed to wait for fence");
+
+    upload_job_finish(job);
+}
+
+/**
+ * Frees a job, waiting for it first if it is not done.
+ */
+void upload_job_release(upload_job_T* job)
+{
+    upload_job_wait(job);
+    free(job->data);
+    free(job);
+}
+
+/**
+ * Runs the jobs still queued and stops the thread.
+ * Their owners may still wait for and release them afterwards,
+ * the caller destroys the upload thread's window.
+ */
+void upload_thread_stop()
+{
+    if (!running)
+        return;
+
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    pthread_join(thread, (void*)0);
+
+    window = (void*)0;
+    running = 0;
+}
@@ -0,0 +1,587 @@
+#include "include/utf8.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define UTF8_X86 1
+#endif
+
+
+/**
+ * Decodes the codepoint at *s and moves *s past it, never reading at or past end.
+ * Malformed, overlong and surrogate sequences decode as UTF8_REPLACEMENT,
+ * a truncated sequence only consumes the bytes that belong to it.
+ */
+static uint32_t utf8_decode_range(const unsigned char** text, const unsigned char* end)
+{
+    const unsigned char* s = *text;
+    uint32_t codepoint = s[0];
+    uint32_t min;
+    int length;
+
+    if (codepoint < 0x80)
+    {
+        *text += 1;
+        return codepoint;
+    }
+    else if ((codepoint & 0xE0) == 0xC0)
+    {
+        length = 2;
+        min = 0x80;
+        codepoint &= 0x1F;
+    }
+    else if ((codepoint & 0xF0) == 0xE0)
+    {
+        length = 3;
+        min = 0x800;
+        codepoint &= 0x0F;
+    }
+    else if ((codepoint & 0xF8) == 0xF0)
+    {
+        length = 4;
+        min = 0x10000;
+        codepoint &= 0x07;
+    }
+    else
+    {
+        // Stray continuation byte or invalid lead byte
+        *text += 1;
+        return UTF8_REPLACEMENT;
+    }
+
+    for (int i = 1; i < length; i++)
+    {
+        if (s + i >= end || (s[i] & 0xC0) != 0x80)
+        {
+            *text += i;
+            return UTF8_REPLACEMENT;
+        }
+
+        codepoint = (codepoint << 6) | (s[i] & 0x3F);
+    }
+
+    *text += length;
+
+    if (codepoint < min || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+        return UTF8_REPLACEMENT;
+
+    return codepoint;
+}
+
+/**
+ * Decodes the codepoint at *text and moves *text past it.
+ * The terminating 0 of the string is never skipped.
+ */
+uint32_t utf8_decode(const char** text)
+{
+    const unsigned char* s = (const unsigned char*) *text;
+
+    // A 0 ends every sequence early, so the string may end before s + 4
+    uint32_t codepoint = utf8_decode_range(&s, s + 4);
+    *text = (const char*) s;
+
+    return codepoint;
+}
+
+static size_t utf8_decode_string_scalar(const char* text, size_t length, uint32_t* codepoints)
+{
+    const unsigned char* s = (const unsigned char*) text;
+    const unsigned char* end = s + length;
+    size_t count = 0;
+
+    while (s < end)
+        codepoints[count++] = utf8_decode_range(&s, end);
+
+    return count;
+}
+
+#ifdef UTF8_X86
+/**
+ * Error classes of the lookup table validator (Keiser and Lemire, "Validating UTF-8 In Less
+ * Than One Instruction Per Byte"). Every byte is classified by three table lookups on the
+ * high and low nibble of the byte before it and the high nibble of itself,
+ * a class set in all three is an error.
+ */
+#define UTF8_TOO_SHORT (1 << 0)     // Lead byte not followed by a continuation byte
+#define UTF8_TOO_LONG (1 << 1)      // Continuation byte after ASCII
+#define UTF8_OVERLONG_3 (1 << 2)
+#define UTF8_TOO_LARGE (1 << 3)     // Above U+10FFFF
+#define UTF8_SURROGATE (1 << 4)
+#define UTF8_OVERLONG_2 (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)
+#define UTF8_TWO_CONTS (1 << 7)     // Continuation byte after a continuation byte, valid in 3 and 4 byte sequences
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define UTF8_TABLE_PREV_HIGH \
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, \
+    UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, \
+    UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, \
+    UTF8_TOO_SHORT | UTF8_OVERLONG_2, \
+    UTF8_TOO_SHORT, \
+    UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE, \
+    UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+
+#define UTF8_TABLE_PREV_LOW \
+    UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4, \
+    UTF8_CARRY | UTF8_OVERLONG_2, \
+    UTF8_CARRY, \
+    UTF8_CARRY, \
+    UTF8_CARRY | UTF8_TOO_LARGE, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000, \
+    UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+
+#define UTF8_TABLE_HIGH \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE, \
+    UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE, \
+    UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+
+/**
+ * Copies the ASCII bytes in front of the first non-ASCII byte of a block,
+ * `mask` has a bit set for every byte with the high bit set.
+ */
+static size_t utf8_copy_ascii_prefix(const unsigned char** s, uint32_t mask, uint32_t* codepoints)
+{
+    size_t prefix = __builtin_ctz(mask);
+
+    for (size_t i = 0; i < prefix; i++)
+        codepoints[i] = (*s)[i];
+
+    *s += prefix;
+
+    return prefix;
+}
+
+/**
+ * Where the last sequence starting in a validated block of `size` bytes runs past its end,
+ * decoding stops in front of it and the next block starts with it.
+ */
+static size_t utf8_block_complete(const unsigned char* s, size_t size)
+{
+    if (s[size - 1] >= 0xC0)
+        return size - 1;
+
+    if (s[size - 2] >= 0xE0)
+        return size - 2;
+
+    if (s[size - 3] >= 0xF0)
+        return size - 3;
+
+    return size;
+}
+
+/**
+ * Assembles the codepoints of validated bytes. `wide` holds every byte of the block widened,
+ * ASCII runs are copied from it. `multibyte` has a bit set for every byte that starts a longer
+ * sequence, whose length is the distance to the next start, and `size` ends the last one.
+ * No branch depends on the bytes: four are always packed 6 bits apart
+ * and the ones past the sequence shifted out. `s` must have 3 readable bytes past `size`.
+ */
+static size_t utf8_decode_valid(const unsigned char* s, const uint32_t* wide, uint32_t multibyte, uint32_t starts, size_t size, uint32_t* codepoints)
+{
+    static const unsigned char lead_masks[5] = { 0, 0x7F, 0x1F, 0x0F, 0x07 };
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i < size)
+    {
+        size_t next = multibyte != 0 ? (size_t) __builtin_ctz(multibyte) : size;
+
+        while (i < next)
+            codepoints[count++] = wide[i++];
+
+        if (i >= size)
+            break;
+
+        multibyte &= multibyte - 1;
+
+        uint32_t after = starts & ~((2u << i) - 1);
+        size_t length = (after != 0 ? (size_t) __builtin_ctz(after) : size) - i;
+        const unsigned char* b = s + i;
+
+        uint32_t bits = ((uint32_t) (b[0] & lead_masks[length]) << 18)
+            | ((uint32_t) (b[1] & 0x3F) << 12)
+            | ((uint32_t) (b[2] & 0x3F) << 6)
+            | (b[3] & 0x3F);
+
+        codepoints[count++] = bits >> (6 * (4 - length));
+        i += length;
+    }
+
+    return count;
+}
+
+/**
+ * Decodes a validated block, runs of two byte sequences (Latin, Greek, Cyrillic)
+ * and three byte sequences (CJK) are shuffled into 32 bit lanes and assembled
+ * four or eight at a time. `block` must have 16 readable bytes past `size`.
+ * Always inlined, so the AVX2 decoder gets a VEX encoded copy and never mixes in legacy SSE.
+ */
+__attribute__((target("ssse3"), always_inline))
+static inline size_t utf8_decode_block_ssse3(const unsigned char* block, const uint32_t* wide, uint32_t multibyte, uint32_t starts, size_t size, uint32_t* codepoints)
+{
+    // Every lane gathers the bytes of one sequence, last byte lowest
+    const __m128i two_low = _mm_setr_epi8(1, 0, -1, -1, 3, 2, -1, -1, 5, 4, -1, -1, 7, 6, -1, -1);
+    const __m128i two_high = _mm_setr_epi8(9, 8, -1, -1, 11, 10, -1, -1, 13, 12, -1, -1, 15, 14, -1, -1);
+    const __m128i three = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+    size_t count = 0;
+    size_t i = 0;
+
+    while (1)
+    {
+        uint32_t lead = starts >> i;
+        uint32_t high = multibyte >> i;
+
+        // The sequence after the run must start right behind it, or the last one would be longer
+        if (i + 16 <= size && (lead & 0xFFFF) == 0x5555 && (high & 0x5555) == 0x5555
+            && (i + 16 == size || (lead & 0x10000)))
+        {
+            __m128i bytes = _mm_loadu_si128((const __m128i*) (block + i));
+            __m128i masks = _mm_set1_epi32(0x1F3F);
+
+            __m128i low = _mm_and_si128(_mm_shuffle_epi8(bytes, two_low), masks);
+            __m128i high = _mm_and_si128(_mm_shuffle_epi8(bytes, two_high), masks);
+
+            low = _mm_or_si128(
+                _mm_and_si128(low, _mm_set1_epi32(0x3F)),
+                _mm_and_si128(_mm_srli_epi32(low, 2), _mm_set1_epi32(0x7C0))
+            );
+            high = _mm_or_si128(
+                _mm_and_si128(high, _mm_set1_epi32(0x3F)),
+                _mm_and_si128(_mm_srli_epi32(high, 2), _mm_set1_epi32(0x7C0))
+            );
+
+            _mm_storeu_si128((__m128i*) &codepoints[count], low);
+            _mm_storeu_si128((__m128i*) &codepoints[count + 4], high);
+
+            i += 16;
+            count += 8;
+        }
+        else if (i + 12 <= size && (lead & 0xFFF) == 0x249 && (high & 0x249) == 0x249
+            && (i + 12 == size || (lead & 0x1000)))
+        {
+            __m128i bytes = _mm_loadu_si128((const __m128i*) (block + i));
+            __m128i lanes = _mm_and_si128(_mm_shuffle_epi8(bytes, three), _mm_set1_epi32(0x0F3F3F));
+
+            lanes = _mm_or_si128(
+                _mm_or_si128(
+                    _mm_and_si128(lanes, _mm_set1_epi32(0x3F)),
+                    _mm_and_si128(_mm_srli_epi32(lanes, 2), _mm_set1_epi32(0x0FC0))
+                ),
+                _mm_and_si128(_mm_srli_epi32(lanes, 4), _mm_set1_epi32(0xF000))
+            );
+
+            _mm_storeu_si128((__m128i*) &codepoints[count], lanes);
+
+            i += 12;
+            count += 4;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (i >= size)
+        return count;
+
+    return count + utf8_decode_valid(block + i, wide + i, multibyte >> i, starts >> i, size - i, &codepoints[count]);
+}
+
+/**
+ * Widens 16 bytes at a time while they are all ASCII.
+ * Only used on CPUs without SSSE3, anything else goes through the scalar decoder.
+ */
+__attribute__((target("sse2")))
+static size_t utf8_decode_string_sse2(const char* text, size_t length, uint32_t* codepoints)
+{
+    const unsigned char* s = (const unsigned char*) text;
+    const unsigned char* end = s + length;
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+
+    while (s < end)
+    {
+        if (end - s >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128((const __m128i*) s);
+            uint32_t mask = _mm_movemask_epi8(chunk);
+
+            if (mask == 0)
+            {
+                __m128i low = _mm_unpacklo_epi8(chunk, zero);
+                __m128i high = _mm_unpackhi_epi8(chunk, zero);
+
+                _mm_storeu_si128((__m128i*) &codepoints[count], _mm_unpacklo_epi16(low, zero));
+                _mm_storeu_si128((__m128i*) &codepoints[count + 4], _mm_unpackhi_epi16(low, zero));
+                _mm_storeu_si128((__m128i*) &codepoints[count + 8], _mm_unpacklo_epi16(high, zero));
+                _mm_storeu_si128((__m128i*) &codepoints[count + 12], _mm_unpackhi_epi16(high, zero));
+
+                s += 16;
+                count += 16;
+                continue;
+            }
+
+            count += utf8_copy_ascii_prefix(&s, mask, &codepoints[count]);
+        }
+
+        codepoints[count++] = utf8_decode_range(&s, end);
+    }
+
+    return count;
+}
+
+/**
+ * Validates a 16 byte block that starts a sequence, the bytes in front of it are taken as ASCII.
+ * Returns a mask of the bytes with an error, stray continuation bytes at the start included.
+ */
+__attribute__((target("ssse3")))
+static uint32_t utf8_validate_ssse3(__m128i input)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    __m128i prev1 = _mm_alignr_epi8(input, zero, 15);
+    __m128i prev2 = _mm_alignr_epi8(input, zero, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, zero, 13);
+
+    __m128i prev_high = _mm_shuffle_epi8(
+        _mm_setr_epi8(UTF8_TABLE_PREV_HIGH),
+        _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)
+    );
+    __m128i prev_low = _mm_shuffle_epi8(_mm_setr_epi8(UTF8_TABLE_PREV_LOW), _mm_and_si128(prev1, nibble));
+    __m128i high = _mm_shuffle_epi8(
+        _mm_setr_epi8(UTF8_TABLE_HIGH),
+        _mm_and_si128(_mm_srli_epi16(input, 4), nibble)
+    );
+    __m128i special = _mm_and_si128(_mm_and_si128(prev_high, prev_low), high);
+
+    // Two continuation bytes in a row are only valid as the third and fourth byte of a sequence
+    __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8((char) (0xE0 - 0x80)));
+    __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char) (0xF0 - 0x80)));
+    __m128i expected = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char) 0x80));
+
+    __m128i error = _mm_xor_si128(expected, special);
+
+    return ~_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) & 0xFFFF;
+}
+
+/**
+ * Validates and classifies 16 bytes at a time, whole blocks of ASCII are widened.
+ * Valid blocks are assembled from their sequence starts, the scalar decoder
+ * only runs up to the first error of a block.
+ */
+__attribute__((target("ssse3")))
+static size_t utf8_decode_string_ssse3(const char* text, size_t length, uint32_t* codepoints)
+{
+    const unsigned char* s = (const unsigned char*) text;
+    const unsigned char* end = s + length;
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+
+    while (end - s >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i*) s);
+        uint32_t mask = _mm_movemask_epi8(chunk);
+
+        if (mask == 0)
+        {
+            __m128i low = _mm_unpacklo_epi8(chunk, zero);
+            __m128i high = _mm_unpackhi_epi8(chunk, zero);
+
+            _mm_storeu_si128((__m128i*) &codepoints[count], _mm_unpacklo_epi16(low, zero));
+            _mm_storeu_si128((__m128i*) &codepoints[count + 4], _mm_unpackhi_epi16(low, zero));
+            _mm_storeu_si128((__m128i*) &codepoints[count + 8], _mm_unpacklo_epi16(high, zero));
+            _mm_storeu_si128((__m128i*) &codepoints[count + 12], _mm_unpackhi_epi16(high, zero));
+
+            s += 16;
+            count += 16;
+            continue;
+        }
+
+        uint32_t errors = utf8_validate_ssse3(chunk);
+
+        if (errors != 0)
+        {
+            // Sequences ending before the first error are valid, the scalar decoder handles the rest
+            const unsigned char* stop = s + __builtin_ctz(errors) + 1;
+
+            while (s < stop)
+                codepoints[count++] = utf8_decode_range(&s, end);
+
+            continue;
+        }
+
+        // Continuation bytes are the only ones in 0x80 to 0xBF, signed -128 to -65
+        uint32_t continuations = _mm_movemask_epi8(_mm_cmplt_epi8(chunk, _mm_set1_epi8((char) 0xC0)));
+        size_t size = utf8_block_complete(s, 16);
+        uint32_t starts = ~continuations & ((1u << size) - 1);
+
+        // Reads past the last sequence of the block land in the padding
+        unsigned char block[16 + 16] = { 0 };
+        uint32_t wide[16];
+        __m128i low = _mm_unpacklo_epi8(chunk, zero);
+        __m128i high = _mm_unpackhi_epi8(chunk, zero);
+
+        _mm_storeu_si128((__m128i*) block, chunk);
+        _mm_storeu_si128((__m128i*) &wide[0], _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128((__m128i*) &wide[4], _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128((__m128i*) &wide[8], _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128((__m128i*) &wide[12], _mm_unpackhi_epi16(high, zero));
+
+        count += utf8_decode_block_ssse3(block, wide, starts & mask, starts, size, &codepoints[count]);
+        s += size;
+    }
+
+    while (s < end)
+        codepoints[count++] = utf8_decode_range(&s, end);
+
+    return count;
+}
+
+/**
+ * Same as the SSSE3 version with 32 byte blocks.
+ */
+__attribute__((target("avx2")))
+static uint32_t utf8_validate_avx2(__m256i input)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    // The bytes in front of every lane, the ones in front of the block are ASCII
+    __m256i shifted = _mm256_permute2x128_si256(zero, input, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(input, shifted, 15);
+    __m256i prev2 = _mm256_alignr_epi8(input, shifted, 14);
+    __m256i prev3 = _mm256_alignr_epi8(input, shifted, 13);
+
+    __m256i prev_high = _mm256_shuffle_epi8(
+        _mm256_setr_epi8(UTF8_TABLE_PREV_HIGH, UTF8_TABLE_PREV_HIGH),
+        _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)
+    );
+    __m256i prev_low = _mm256_shuffle_epi8(
+        _mm256_setr_epi8(UTF8_TABLE_PREV_LOW, UTF8_TABLE_PREV_LOW),
+        _mm256_and_si256(prev1, nibble)
+    );
+    __m256i high = _mm256_shuffle_epi8(
+        _mm256_setr_epi8(UTF8_TABLE_HIGH, UTF8_TABLE_HIGH),
+        _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)
+    );
+    __m256i special = _mm256_and_si256(_mm256_and_si256(prev_high, prev_low), high);
+
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char) (0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char) (0xF0 - 0x80)));
+    __m256i expected = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char) 0x80));
+
+    __m256i error = _mm256_xor_si256(expected, special);
+
+    return ~(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(error, zero));
+}
+
+__attribute__((target("avx2")))
+static size_t utf8_decode_string_avx2(const char* text, size_t length, uint32_t* codepoints)
+{
+    const unsigned char* s = (const unsigned char*) text;
+    const unsigned char* end = s + length;
+    size_t count = 0;
+
+    while (end - s >= 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) s);
+        uint32_t mask = _mm256_movemask_epi8(chunk);
+
+        if (mask == 0)
+        {
+            for (int i = 0; i < 32; i += 8)
+            {
+                __m128i bytes = _mm_loadl_epi64((const __m128i*) (s + i));
+                _mm256_storeu_si256((__m256i*) &codepoints[count + i], _mm256_cvtepu8_epi32(bytes));
+            }
+
+            s += 32;
+            count += 32;
+            continue;
+        }
+
+        uint32_t errors = utf8_validate_avx2(chunk);
+
+        if (errors != 0)
+        {
+            const unsigned char* stop = s + __builtin_ctz(errors) + 1;
+
+            while (s < stop)
+                codepoints[count++] = utf8_decode_range(&s, end);
+
+            continue;
+        }
+
+        uint32_t continuations = _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8((char) 0xC0), chunk));
+        size_t size = utf8_block_complete(s, 32);
+        uint32_t starts = ~continuations & (uint32_t) ((1ull << size) - 1);
+
+        unsigned char block[32 + 16] = { 0 };
+        uint32_t wide[32];
+
+        _mm256_storeu_si256((__m256i*) block, chunk);
+
+        for (int i = 0; i < 32; i += 8)
+            _mm256_storeu_si256((__m256i*) &wide[i], _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (s + i))));
+
+        count += utf8_decode_block_ssse3(block, wide, starts & mask, starts, size, &codepoints[count]);
+        s += size;
+    }
+
+    while (s < end)
+        codepoints[count++] = utf8_decode_range(&s, end);
+
+    return count;
+}
+#endif
+
+typedef size_t (*utf8_decode_string_fn)(const char* text, size_t length, uint32_t* codepoints);
+
+static utf8_decode_string_fn utf8_pick_decoder()
+{
+#ifdef UTF8_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        return utf8_decode_string_avx2;
+
+    if (__builtin_cpu_supports("ssse3"))
+        return utf8_decode_string_ssse3;
+
+    if (__builtin_cpu_supports("sse2"))
+        return utf8_decode_string_sse2;
+#endif
+
+    return utf8_decode_string_scalar;
+}
+
+/**
+ * Decodes `length` bytes of UTF-8 into `codepoints`, which must have room for `length` entries.
+ * With SSSE3 or AVX2, blocks are validated and their sequence starts found with SIMD,
+ * blocks of ASCII are widened and valid blocks assembled without further checks.
+ * Blocks with a malformed sequence fall back to the scalar decoder up to the error.
+ * Returns the amount of codepoints written.
+ */
+size_t utf8_decode_string(const char* text, size_t length, uint32_t* codepoints)
+{
+    static utf8_decode_string_fn decoder = (void*)0;
+
+    if (decoder == (void*)0)
+        decoder = utf8_pick_decoder();
+
+    return decoder(text, length, codepoints);
+}
@@ -0,0 +1,276 @@
+#include "../src/include/font.h"
+#include "../src/include/glyph_cache.h"
+#include "../src/include/atlas.h"
+#include "../src/include/baked.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Bakes glyphs of fonts into a file the renderer loads with baked_load,
+ * either as a binary blob or as C source defining the same bytes.
+ *
+ *     fontbake [-o output] [-c symbol] font size ranges [font size ranges ...]
+ *
+ * Ranges are comma separated hexadecimal codepoints or ranges, e.g. 20-7E,A0-FF.
+ * Codepoints the font has no glyph for are skipped.
+ */
+
+#define FONTBAKE_MAX_FONTS 64
+
+static void fontbake_usage()
+{
+    fprintf(stderr, "Usage: fontbake [-o output] [-c symbol] font size ranges [font size ranges ...]\n");
+    fprintf(stderr, "       ranges are hexadecimal, e.g. 20-7E,A0-FF\n");
+}
+
+static int fontbake_has_glyph(font_T* font, uint32_t codepoint)
+{
+    FT_Face face = font_lock(font);
+    int has_glyph = FT_Get_Char_Index(face, codepoint) != 0;
+    font_unlock(font);
+
+    return has_glyph;
+}
+
+static int fontbake_add_ranges(font_T* font, const char* ranges)
+{
+    const char* c = ranges;
+
+    while (*c != 0)
+    {
+        char* end;
+        unsigned long first = strtoul(c, &end, 16);
+        unsigned long last = first;
+
+        if (end == c)
+            return 0;
+
+        if (*end == '-')
+        {
+            c = end + 1;
+            last = strtoul(c, &end, 16);
+
+            if (end == c)
+                return 0;
+        }
+
+        for (unsigned long codepoint = first; codepoint <= last && codepoint <= 0x10FFFF; codepoint++)
+        {
+            if (fontbake_has_glyph(font, codepoint))
+                glyph_cache_get(font, codepoint);
+        }
+
+        c = end;
+
+        if (*c == ',')
+            c++;
+        else if (*c != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+static void fontbake_append(unsigned char** data, size_t* size, const void* bytes, size_t length)
+{
+    *data = realloc(*data, *size + length);
+    memcpy(*data + *size, bytes, length);
+    *size += length;
+}
+
+static int fontbake_write_c(FILE* file, const char* symbol, const unsigned char* data, size_t size)
+{
+    fprintf(file, "/* Generated by fontbake, pass to baked_load */\n");
+    fprintf(file, "#include <stddef.h>\n\n");
+    fprintf(file, "const size_t %s_size = %zu;\n\n", symbol, size);
+    fprintf(file, "const unsigned char %s[] = {", symbol);
+
+    for (size_t i = 0; i < size; i++)
+        fprintf(file, "%s0x%02x,", i % 16 == 0 ? "\n    " : " ", data[i]);
+
+    fprintf(file, "\n};\n");
+
+    return !ferror(file);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* output = "fonts.fglb";
+    const char* symbol = (void*)0;
+    font_T* fonts[FONTBAKE_MAX_FONTS];
+    const char* paths[FONTBAKE_MAX_FONTS];
+    size_t fonts_size = 0;
+
+    // Glyphs are packed on the CPU only, no window or context is needed
+    atlas_set_headless(1);
+
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i += 2)
+    {
+        if (i + 1 >= argc)
+        {
+            fontbake_usage();
+            return 1;
+        }
+
+        if (strcmp(argv[i], "-o") == 0)
+            output = argv[i + 1];
+        else if (strcmp(argv[i], "-c") == 0)
+            symbol = argv[i + 1];
+        else
+        {
+            fontbake_usage();
+            return 1;
+        }
+    }
+
+    if (i == argc || (argc - i) % 3 != 0)
+    {
+        fontbake_usage();
+        return 1;
+    }
+
+    for (; i < argc; i += 3)
+    {
+        if (fonts_size == FONTBAKE_MAX_FONTS)
+        {
+            fprintf(stderr, "ERROR::FONTBAKE: Too many fonts\n");
+            return 1;
+        }
+
+        font_T* font = font_open(argv[i], 0, atoi(argv[i + 1]), FONT_MODE_BITMAP);
+
+        if (font == (void*)0)
+            return 1;
+
+        if (!fontbake_add_ranges(font, argv[i + 2]))
+        {
+            fprintf(stderr, "ERROR::FONTBAKE: Invalid ranges '%s'\n", argv[i + 2]);
+            return 1;
+        }
+
+        paths[fonts_size] = argv[i];
+        fonts[fonts_size] = font;
+        fonts_size += 1;
+    }
+
+    /**
+     * Lay out the baked data in memory
+     */
+    unsigned char* data = (void*)0;
+    size_t size = 0;
+    size_t glyphs_size = 0;
+
+    for (size_t f = 0; f < fonts_size; f++)
+        glyphs_size += glyph_cache_list(fonts[f], (void*)0, (void*)0, 0);
+
+    // Pages are cropped to the lowest glyph, the rest of them is empty
+    int page_height = 1;
+    for (size_t p = 0; p < atlas_get_page_count(); p++)
+    {
+        int used_height = atlas_get_used_height(atlas_get_page(p));
+
+        if (used_height > page_height)
+            page_height = used_height;
+    }
+
+    baked_header_T header;
+    memset(&header, 0, sizeof(struct BAKED_HEADER_STRUCT));
+    memcpy(header.magic, BAKED_MAGIC, 4);
+    header.version = BAKED_VERSION;
+    header.page_width = ATLAS_PAGE_SIZE;
+    header.page_height = page_height;
+    header.pages_size = atlas_get_page_count();
+    header.fonts_size = fonts_size;
+    header.glyphs_size = glyphs_size;
+    fontbake_append(&data, &size, &header, sizeof(struct BAKED_HEADER_STRUCT));
+
+    uint32_t glyphs_start = 0;
+    for (size_t f = 0; f < fonts_size; f++)
+    {
+        const char* name = strrchr(paths[f], '/');
+
+        baked_font_T info;
+        memset(&info, 0, sizeof(struct BAKED_FONT_STRUCT));
+        snprintf(info.name, BAKED_NAME_SIZE, "%s", name ? name + 1 : paths[f]);
+        info.face_index = fonts[f]->face->index;
+        info.pixel_size = fonts[f]->pixel_size;
+        info.line_height = fonts[f]->line_height;
+        info.glyphs_start = glyphs_start;
+        info.glyphs_size = glyph_cache_list(fonts[f], (void*)0, (void*)0, 0);
+        glyphs_start += info.glyphs_size;
+
+        fontbake_append(&data, &size, &info, sizeof(struct BAKED_FONT_STRUCT));
+    }
+
+    glyph_store_T* store = glyph_store_get();
+
+    for (size_t f = 0; f < fonts_size; f++)
+    {
+        size_t count = glyph_cache_list(fonts[f], (void*)0, (void*)0, 0);
+        uint32_t* codepoints = malloc(sizeof(uint32_t) * (count + 1));
+        glyph_id_T* ids = malloc(sizeof(glyph_id_T) * (count + 1));
+        glyph_cache_list(fonts[f], codepoints, ids, count);
+
+        for (size_t g = 0; g < count; g++)
+        {
+            glyph_id_T id = ids[g];
+
+            baked_glyph_T glyph;
+            memset(&glyph, 0, sizeof(struct BAKED_GLYPH_STRUCT));
+            glyph.codepoint = codepoints[g];
+            glyph.advance = store->advance[id];
+            glyph.bearing_left = store->bearing_left[id];
+            glyph.bearing_top = store->bearing_top[id];
+            glyph.width = store->width[id];
+            glyph.height = store->height[id];
+            glyph.atlas_x = store->atlas_x[id];
+            glyph.atlas_y = store->atlas_y[id];
+            glyph.page = store->page[id];
+
+            fontbake_append(&data, &size, &glyph, sizeof(struct BAKED_GLYPH_STRUCT));
+        }
+
+        free(codepoints);
+        free(ids);
+    }
+
+    for (size_t p = 0; p < atlas_get_page_count(); p++)
+        fontbake_append(&data, &size, atlas_get_page(p)->pixels, (size_t) ATLAS_PAGE_SIZE * page_height);
+
+    /**
+     * Write it out
+     */
+    FILE* file = fopen(output, symbol ? "w" : "wb");
+
+    if (file == (void*)0)
+    {
+        perror("ERROR::FONTBAKE: Failed to open output");
+        return 1;
+    }
+
+    int success = symbol
+        ? fontbake_write_c(file, symbol, data, size)
+        : fwrite(data, 1, size, file) == size;
+
+    success = (fclose(file) == 0) && success;
+
+    if (!success)
+    {
+        perror("ERROR::FONTBAKE: Failed to write output");
+        return 1;
+    }
+
+    fprintf(stdout, "Baked %zu glyphs of %zu fonts into %u pages: %s\n", glyphs_size, fonts_size, header.pages_size, output);
+
+    for (size_t f = 0; f < fonts_size; f++)
+        font_close(fonts[f]);
+
+    free(data);
+    glyph_store_free();
+    atlas_free();
+
+    return 0;
+}